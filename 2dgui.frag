@@ -1,11 +1,18 @@
 #version 330
 
-// Really simple fragment shader just textures it
-in vec3 ex_tex;
+// Really simple fragment shader just textures it, from either a texture or an atlas layer
+in vec4 ex_tex;
 
 uniform sampler2D tex;
+uniform sampler2DArray texArray;
+uniform bool un_layered;
 
 void main(void) {
-	vec4 texSample = texture2D(tex, ex_tex.xy);
+	vec4 texSample;
+
+	if (un_layered)
+		texSample = texture(texArray, vec3(ex_tex.xy, floor(ex_tex.w * 65535.0 + 0.5)));
+	else
+		texSample = texture2D(tex, ex_tex.xy);
 	gl_FragColor = vec4(texSample.rgb, ex_tex.z * texSample.a);
 }
@@ -2,13 +2,28 @@
 
 // Really simple vertex shader for 2D items
 
-// 3D coordinate input
+// 3D coordinate input, or the bottom left corner of an instanced quad
 in vec3 in_vert;
-in vec3 in_tex;
+in vec4 in_tex;
 
-out vec3 ex_tex;
+// Top right corner of an instanced quad
+in vec2 in_vert_max;
+in vec2 in_tex_max;
+
+// Instanced quads are expanded from their corners as a triangle strip
+uniform bool un_instanced;
+
+// Texture coordinates, alpha, and atlas layer
+out vec4 ex_tex;
 
 void main(void) {
-	gl_Position = vec4(in_vert.xy, in_vert.z, 1);
-	ex_tex = in_tex;
+	if (un_instanced) {
+		vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+		gl_Position = vec4(mix(in_vert.xy, in_vert_max, corner), in_vert.z, 1);
+		ex_tex = vec4(mix(in_tex.xy, in_tex_max, corner), in_tex.zw);
+	}
+	else {
+		gl_Position = vec4(in_vert.xy, in_vert.z, 1);
+		ex_tex = in_tex;
+	}
 }
@@ -2,13 +2,25 @@
 
 // Really simple untextured 2D quad shader
 
-// 3D coordinate input, should have a fixed Z for 2d
+// 3D coordinate input, should have a fixed Z for 2d, or the bottom left corner of an instanced quad
 in vec3 in_vert;
 in vec4 in_color;
 
+// Top right corner of an instanced quad
+in vec2 in_vert_max;
+
+// Instanced quads are expanded from their corners as a triangle strip
+uniform bool un_instanced;
+
 out vec4 ex_color;
 
 void main(void) {
-	gl_Position = vec4(in_vert.xy, in_vert.z, 1);
+	if (un_instanced) {
+		vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+		gl_Position = vec4(mix(in_vert.xy, in_vert_max, corner), in_vert.z, 1);
+	}
+	else {
+		gl_Position = vec4(in_vert.xy, in_vert.z, 1);
+	}
 	ex_color = in_color;
 }
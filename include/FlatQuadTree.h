@@ -0,0 +1,417 @@
+#ifndef _GUI2D_FLAT_QUADTREE_H_
+#define _GUI2D_FLAT_QUADTREE_H_
+/**
+ * @class gui2d::FlatQuadTree
+ * A QuadTree whose nodes all live in one array, so that lookups walk contiguous memory instead
+ * of following pointers between separately allocated nodes and list cells. The four children
+ * of a node are stored next to each other and referred to by the index of the first one, and
+ * each leaf keeps its items in a small fixed array within the node. Leaves at the maximum depth
+ * that fill up chain further buckets, which are taken from the same array.
+ *
+ * Nodes released when a subtree empties are kept for reuse, and the whole tree is released
+ * with its array. It has the same interface and subdivision rules as QuadTree, and can also
+ * pass what it finds to a callback, so that lookups need not allocate at all.
+ * @tparam T The type of item that this QuadTree tracks. It MUST implement iMBR
+ */
+
+// Standard headers
+#include <vector>
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/iMBR.h"
+
+namespace gui2d {
+
+template <class T>
+class FlatQuadTree : public iMBR {
+public:
+	static const int MAX_DEPTH = 10;	//!< Depth after which leaves chain buckets instead of dividing
+	static const int LEAF_SIZE = 4;		//!< Items that a leaf or bucket holds before it divides or chains
+	static const int NONE = -1;			//!< Index used for a missing child or bucket
+
+	/**
+	 * A node of the tree, which is either divided into four children or is a leaf holding
+	 * items. Buckets chained from a leaf use the same structure, without bounds of their own.
+	 */
+	struct Node {
+		glm::vec4 bounds;			//!< Area covered by the node
+		int children;				//!< Index of the first of four consecutive children, or NONE for a leaf
+		int depth;					//!< Depth relative to the root, which is at depth one
+		int count;					//!< Number of items held in this node or bucket
+		int next;					//!< Next bucket of a leaf at the maximum depth, or NONE
+		T *items[LEAF_SIZE];		//!< Items whose bounds overlap the node
+	};
+
+private:
+	/**
+	 * Callback for locate() that collects the items found
+	 */
+	struct Append {
+		std::vector<T*>& results;
+
+		Append(std::vector<T*>& r) : results(r) {}
+
+		bool operator()(T *item) {
+			results.push_back(item);
+			return true;
+		}
+	};
+
+	std::vector<Node> _nodes;		// Every node and bucket, with the root first
+	std::vector<int> _freeBlocks;	// Runs of four nodes released by undivide()
+	std::vector<int> _freeBuckets;	// Buckets released when a leaf's items were removed
+
+	/**
+	 * Tests a point against an area, the same way that iMBR::contains() does
+	 */
+	static bool containsPoint(const glm::vec4& bounds, float x, float y) {
+		return (x >= bounds[MIN_X] && x <= bounds[MAX_X]) && (y >= bounds[MIN_Y] && y <= bounds[MAX_Y]);
+	}
+
+	/**
+	 * Tests an item against an area, the same way that iMBR::overlaps() does
+	 */
+	static bool overlapsBounds(const glm::vec4& bounds, const iMBR& other) {
+		const glm::vec4& otherBounds = other.getMBR();
+
+		return !(otherBounds[MAX_X] < bounds[MIN_X] || otherBounds[MIN_X] > bounds[MAX_X] ||
+					otherBounds[MAX_Y] < bounds[MIN_Y] || otherBounds[MIN_Y] > bounds[MAX_Y]);
+	}
+
+	/**
+	 * Takes a number of consecutive nodes, reusing released ones where possible. This may move
+	 * every node, so no references to them may be held across it.
+	 * @param count The number of nodes, which is four for children and one for a bucket
+	 * @return Index of the first node
+	 */
+	int allocate(int count) {
+		std::vector<int>& freeList = (count == 4) ? _freeBlocks : _freeBuckets;
+		int index;
+
+		if (!freeList.empty()) {
+			index = freeList.back();
+			freeList.pop_back();
+			return index;
+		}
+
+		index = _nodes.size();
+		_nodes.resize(_nodes.size() + count);
+		return index;
+	}
+
+	/**
+	 * Subdivide a leaf into four children and move its items into them
+	 * @param index The leaf to divide
+	 */
+	void divide(int index) {
+		T *items[LEAF_SIZE];
+		int count = _nodes[index].count;
+		int first, i;
+		glm::vec4 bounds;
+
+		for (i = 0; i < count; ++i) {
+			items[i] = _nodes[index].items[i];
+		}
+
+		first = allocate(4);
+		Node& node = _nodes[index];
+		bounds = node.bounds;
+
+		for (i = 0; i < 4; ++i) {
+			_nodes[first + i].children = NONE;
+			_nodes[first + i].depth = node.depth + 1;
+			_nodes[first + i].count = 0;
+			_nodes[first + i].next = NONE;
+		}
+
+		_nodes[first].bounds = glm::vec4(bounds[MIN_X], (bounds[MIN_X]+bounds[MAX_X])/2,
+											bounds[MIN_Y], (bounds[MIN_Y]+bounds[MAX_Y])/2);
+		_nodes[first + 1].bounds = glm::vec4((bounds[MIN_X]+bounds[MAX_X])/2, bounds[MAX_X],
+											bounds[MIN_Y], (bounds[MIN_Y]+bounds[MAX_Y])/2);
+		_nodes[first + 2].bounds = glm::vec4((bounds[MIN_X]+bounds[MAX_X])/2, bounds[MAX_X],
+											(bounds[MIN_Y]+bounds[MAX_Y])/2, bounds[MAX_Y]);
+		_nodes[first + 3].bounds = glm::vec4(bounds[MIN_X], (bounds[MIN_X]+bounds[MAX_X])/2,
+											(bounds[MIN_Y]+bounds[MAX_Y])/2, bounds[MAX_Y]);
+
+		node.children = first;
+		node.count = 0;
+
+		for (i = 0; i < count; ++i) {
+			insert(first, items[i]);
+			insert(first + 1, items[i]);
+			insert(first + 2, items[i]);
+			insert(first + 3, items[i]);
+		}
+	}
+
+	/**
+	 * Releases the children of a node once all of them are empty leaves, which makes the node
+	 * a leaf again
+	 * @param index The node to try to undivide
+	 */
+	void undivide(int index) {
+		int first = _nodes[index].children;
+		int i;
+
+		for (i = 0; i < 4; ++i) {
+			if (_nodes[first + i].children != NONE || _nodes[first + i].count != 0)
+				return;
+		}
+
+		_freeBlocks.push_back(first);
+		_nodes[index].children = NONE;
+	}
+
+	/**
+	 * Inserts an item below a node, doing subdivision if necessary
+	 * @param index The node to insert into
+	 * @param item The item to insert
+	 */
+	void insert(int index, T *item) {
+		int bucket, i;
+
+		if (!overlapsBounds(_nodes[index].bounds, *item))
+			return;
+
+		if (_nodes[index].children != NONE) {
+			for (i = 0; i < 4; ++i) {
+				insert(_nodes[index].children + i, item);
+			}
+			return;
+		}
+
+		if (_nodes[index].count == LEAF_SIZE && _nodes[index].depth < MAX_DEPTH) {
+			divide(index);
+			insert(index, item);
+			return;
+		}
+
+		// Leaves at the maximum depth keep chaining buckets instead
+		bucket = index;
+		while (_nodes[bucket].count == LEAF_SIZE && _nodes[bucket].next != NONE) {
+			bucket = _nodes[bucket].next;
+		}
+
+		if (_nodes[bucket].count == LEAF_SIZE) {
+			i = allocate(1);
+			_nodes[i].children = NONE;
+			_nodes[i].depth = _nodes[bucket].depth;
+			_nodes[i].count = 0;
+			_nodes[i].next = NONE;
+			_nodes[bucket].next = i;
+			bucket = i;
+		}
+
+		_nodes[bucket].items[_nodes[bucket].count++] = item;
+	}
+
+	/**
+	 * Removes an item from a leaf and its buckets, filling each hole with the last item so that
+	 * only the last bucket is ever partly full, and releasing that bucket once it is empty
+	 * @param index The leaf to remove from
+	 * @param item The item to remove
+	 */
+	void removeItem(int index, T *item) {
+		int bucket, last, prev, i;
+
+		for (bucket = index; bucket != NONE; bucket = _nodes[bucket].next) {
+			i = 0;
+			while (i < _nodes[bucket].count) {
+				if (_nodes[bucket].items[i] != item) {
+					++i;
+					continue;
+				}
+
+				prev = NONE;
+				for (last = index; _nodes[last].next != NONE; last = _nodes[last].next) {
+					prev = last;
+				}
+
+				_nodes[last].count -= 1;
+				_nodes[bucket].items[i] = _nodes[last].items[_nodes[last].count];
+
+				if (_nodes[last].count == 0 && last != index) {
+					_nodes[prev].next = NONE;
+					_freeBuckets.push_back(last);
+					if (last == bucket)
+						return;
+				}
+			}
+		}
+	}
+
+	/**
+	 * Removes an item from below a node, undividing the nodes that become empty
+	 * @param index The node to remove from
+	 * @param item The item to remove
+	 */
+	void remove(int index, T *item) {
+		int i;
+
+		if (!overlapsBounds(_nodes[index].bounds, *item))
+			return;
+
+		if (_nodes[index].children == NONE) {
+			removeItem(index, item);
+			return;
+		}
+
+		// Forward to each child (an item may be in multiple children, they will test)
+		for (i = 0; i < 4; ++i) {
+			remove(_nodes[index].children + i, item);
+		}
+		undivide(index);
+	}
+
+public:
+	/**
+	 * Constructor, creates the root as an empty leaf
+	 * @param bounds The minimum bounding rectangle of the whole tree
+	 */
+	FlatQuadTree(const glm::vec4& bounds) : iMBR(bounds) {
+		_nodes.resize(1);
+		_nodes[0].bounds = bounds;
+		_nodes[0].children = NONE;
+		_nodes[0].depth = 1;
+		_nodes[0].count = 0;
+		_nodes[0].next = NONE;
+	}
+
+	/**
+	 * Checks if the tree is empty, which is only the case when the root is an empty leaf
+	 * @return True if this QuadTree is empty, false otherwise
+	 */
+	bool empty(void) const {
+		return _nodes[0].children == NONE && _nodes[0].count == 0;
+	}
+
+	/**
+	 * Inserts an item into the QuadTree, doing subdivision if necessary
+	 * @param item The item to insert
+	 */
+	void insert(T *item) {
+		insert(0, item);
+	}
+
+	/**
+	 * Removes an item from the QuadTree, undividing nodes that become empty
+	 * @param item The item to remove
+	 */
+	void remove(T *item) {
+		remove(0, item);
+	}
+
+	/**
+	 * Passes each item whose MBR overlaps with the x, y coordinates given to a callback,
+	 * visiting the nodes in the same order that QuadTree does, without allocating
+	 * @param x The x coordinate of the test
+	 * @param y The y coordinate of the test
+	 * @param visit Callback taking a T*, which returns false to stop the search
+	 * @return The number of items passed to visit
+	 */
+	template <class F>
+	int locate(float x, float y, F& visit) const {
+		// Each level replaces one node with at most four children
+		int stack[3*MAX_DEPTH + 1];
+		int top = 0;
+		int found = 0;
+		int i;
+		const Node *node;
+
+		if (!containsPoint(_nodes[0].bounds, x, y))
+			return 0;
+
+		stack[top++] = 0;
+		while (top > 0) {
+			node = &_nodes[stack[--top]];
+
+			if (node->children != NONE) {
+				for (i = 3; i >= 0; --i) {
+					if (containsPoint(_nodes[node->children + i].bounds, x, y))
+						stack[top++] = node->children + i;
+				}
+				continue;
+			}
+
+			while (true) {
+				for (i = 0; i < node->count; ++i) {
+					if (node->items[i]->contains(x, y)) {
+						found += 1;
+						if (!visit(node->items[i]))
+							return found;
+					}
+				}
+
+				if (node->next == NONE)
+					break;
+				node = &_nodes[node->next];
+			}
+		}
+
+		return found;
+	}
+
+	/**
+	 * Locates all items whose MBRs overlap with the x, y coordinates given
+	 * @param x The x coordinate of the test
+	 * @param y The y coordinate of the test
+	 * @param results The vector in which to store results
+	 * @return The number of items added to results
+	 */
+	int locate(float x, float y, std::vector<T*>& results) const {
+		Append append(results);
+		return locate(x, y, append);
+	}
+
+	/**
+	 * Locates the items whose MBRs overlap with the x, y coordinates given, once each, ordered
+	 * from the topmost to the bottom by their getMouseZ(), so that events can be passed down
+	 * until one is consumed. Items with the same z keep the order that locate() finds them in.
+	 * @param x The x coordinate of the test
+	 * @param y The y coordinate of the test
+	 * @param results The vector in which to store results
+	 * @return The number of items added to results
+	 */
+	int locateTopmost(float x, float y, std::vector<T*>& results) const {
+		size_t first = results.size();
+		size_t end = first;
+		size_t i, j;
+		GLushort z;
+		T *item;
+
+		locate(x, y, results);
+
+		// Sort in place; items on the edges between leaves are found more than once
+		for (i = first; i < results.size(); ++i) {
+			item = results[i];
+			for (j = first; j < end && results[j] != item; ++j) {}
+			if (j < end)
+				continue;
+
+			z = item->getMouseZ();
+			for (j = end; j > first && results[j-1]->getMouseZ() > z; --j) {
+				results[j] = results[j-1];
+			}
+			results[j] = item;
+			end += 1;
+		}
+
+		results.resize(end);
+		return end - first;
+	}
+
+	/**
+	 * Retrieve the number of nodes and buckets in the array, including released ones
+	 * @return The size of the node array
+	 */
+	size_t getNodeCount(void) const { return _nodes.size(); }
+};
+
+};
+
+#endif
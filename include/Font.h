@@ -3,7 +3,29 @@
 /**
  * @class gui2d::Font
  * Font container for the 2D GUI class.
- * @todo Support loading fonts from memory, not just from files
+ *
+ * Glyphs are cached by codepoint and rasterized on demand into a GlyphAtlas that the manager
+ * shares between all fonts, so that text in any font is drawn from the same texture.
+ * Printable ASCII is rasterized when the font is loaded, after reserving room for it in the
+ * atlas. When the atlas is full and cannot grow any further, it evicts the least recently
+ * used glyph of any font. The generation counter changes whenever cached texture coordinates
+ * move, so that strings know to lay themselves out again. Newly rasterized glyphs are
+ * uploaded when the atlas is flushed. A glyph that the atlas has no room for in the middle of
+ * a frame is drawn blank without being cached, and the atlas makes room for it before the
+ * next frame, when the generation changes again.
+ *
+ * A font may instead hold signed distance fields, rasterized once per face at DISTANCE_SIZE
+ * into an atlas that is sampled with linear filtering. Such a font is never drawn directly:
+ * fonts created by scaleFont() share its glyphs and scale its metrics to any pixel size, and
+ * their strings are drawn with a shader that thresholds the distance, which also allows for
+ * outlines and drop shadows. Distance fields need FreeType 2.11 or later.
+ *
+ * Loading is split in two. rasterize() measures and renders the printable ASCII range in a
+ * single pass, and needs nothing but a face, so a FontLoader can run it on worker threads
+ * with libraries of their own. The font itself is then built from the FaceRaster on the GL
+ * thread, which only composites the glyphs into the atlas and uploads them. When the manager
+ * has a font cache, loadRaster() reads the raster from a FontCache file instead, and the face
+ * is not even opened until a glyph outside of the cached range is needed.
  */
 
 // Standard headers
@@ -15,11 +37,22 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+// FT_RENDER_MODE_SDF first appeared in FreeType 2.11
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define GUI2D_DISTANCE_FIELDS
+#endif
+
+#include <stdint.h>
 #include <iostream>
+#include <list>
+#include <map>
 #include <string>
+#include <vector>
 
 // Project definitions
 #include "2dgui/Manager.h"
+#include "2dgui/GlyphAtlas.h"
+#include "2dgui/FontData.h"
 
 namespace gui2d {
 
@@ -40,36 +73,127 @@ public:
 		// Texture normalized which get copied verbatim
 		GLushort tx;	//!< x offset of glyph within the texture
 		GLushort txEnd;	//!< end x offset of glyph within texture
+		GLushort ty;	//!< y offset of the top of the glyph within the texture
+		GLushort tyEnd;	//!< y offset of the bottom of the glyph within the texture
+	};
+
+	/**
+	 * A glyph held in the cache, along with its place in the atlas
+	 */
+	struct CachedGlyph {
+		char_info info;				//!< Drawing information for the glyph
+		GlyphAtlas::Region region;	//!< Atlas region holding the bitmap, with a shelf of -1 if the glyph is blank
+	};
+
+	typedef std::map<uint32_t, CachedGlyph> GlyphMap;	//!< Cached glyphs keyed by codepoint
+
+	/**
+	 * A glyph rendered by FreeType, copied out of the glyph slot so that it can be handed
+	 * from the thread that rendered it to the one that owns the atlas
+	 */
+	struct GlyphBitmap {
+		uint32_t codepoint;				//!< Codepoint of the glyph
+		FT_Pos advance;					//!< advance.x, in 1/64 pixels
+		int left, top;					//!< bitmap_left and bitmap_top
+		int width, rows;				//!< Size of the bitmap, zero if the glyph is blank
+		int ascent, descent;			//!< Extent of the outline above and below the baseline, without any distance field spread
+		std::vector<GLubyte> pixels;	//!< Rows of the bitmap, packed without padding
 	};
 
+	/**
+	 * Everything measured and rendered from a face when it is loaded, none of which needs
+	 * the GL context or the manager, so that it can be produced on any thread
+	 */
+	struct FaceRaster {
+		std::vector<GlyphBitmap> glyphs;	//!< The printable ASCII range, in order
+		std::vector<FT_Pos> kern;			//!< Kerning between each pair of those characters in 1/64 pixels, empty if there is none
+		int maxAscent;						//!< Highest ascent of the glyphs
+		int minDescent;						//!< Lowest descent of the glyphs, which is usually negative
+		int maxWidth;						//!< Widest bitmap
+		size_t widths;						//!< Sum of the bitmap widths, including atlas padding
+	};
+
+	static const int FIRST_CHAR = 32;					//!< First character code that is loaded
+	static const int LAST_CHAR = 128;					//!< One past the last character code that is loaded
+	static const int CHAR_COUNT = LAST_CHAR - FIRST_CHAR;	//!< Number of characters that are loaded
+	static const uint32_t REPLACEMENT_CHAR = 0xFFFD;	//!< Codepoint substituted for malformed UTF-8
+	static const int DISTANCE_SIZE = 48;				//!< Pixel size that distance field glyphs are rasterized at
+	static const int DISTANCE_SPREAD = 8;				//!< Distance in pixels covered by the field on either side of an edge
+
 private:
 	int _id;
 	bool _init;
-	GLuint _texture;
+	int _size;					// Pixel size the font was loaded or scaled to
 	float _height;
-	FT_Bool _kerning;
+	bool _kerning;				// True if any pair of loaded characters has a kerning adjustment
 
 	GLshort _texHeight;			// Normalized to screen coordinates
 	GLshort _maxDescender;		// Absolute value of the max descent value
 	GLushort _maxWidth;			// Maximum character width using advance.x
+	GLshort _padding;			// Normalized room left around each glyph for its distance field
+
+	// Distance fields
+	bool _distanceField;		// Glyphs are rasterized as signed distance fields
+	Font *_source;				// Distance field font whose glyphs this one scales, or null
+	float _scale;				// Size of this font relative to its source
+	char_info _scaled;			// Scaled copy of the last glyph looked up from the source
 
-	char_info _info[128];
+	GLshort _kern[CHAR_COUNT][CHAR_COUNT];	// Normalized kerning for each pair of loaded characters
+
+	// Glyph cache
+	GlyphMap _glyphs;
+	CachedGlyph *_ascii[LAST_CHAR];		// Fast path for ASCII lookups, null if not cached
+	uint32_t _generation;				// Incremented whenever a glyph is evicted, or should be retried
+	CachedGlyph _missing;				// Blank stand-in for the last glyph that the atlas had no room for
+
+	// Shared atlas that glyphs are packed into; every glyph is as tall as the font
+	GlyphAtlas *_atlas;
+	uint32_t _atlasGeneration;			// Atlas generation that the cached texture coordinates match
+	int _glyphHeight;
+	FT_Pos _maxAscent;
 
 	gui2d::Manager *_manager;
-	FT_Face _face;
+	std::ostream *_err;
+	FontData _data;
+	FT_Face _face;				// Opened on the first glyph that was not preloaded, or null
+	bool _faceFailed;			// Opening the face failed, so missing glyphs are left blank
+
+	CachedGlyph *cacheGlyph(uint32_t codepoint);
+	CachedGlyph *storeGlyph(const GlyphBitmap& bitmap);
+	void mapGlyph(CachedGlyph& glyph);
+	void remapGlyphs(void);
 
 public:
 	/**
 	 * The constructor is totally empty, because this font does nothing until
 	 * it is explicitly loaded, since constructors can't produce error messages.
 	 */
-	Font(void) {}
+	Font(void) : _init(false), _distanceField(false), _source(0), _atlas(0) {}
 	~Font(void);
 
 	GLuint getMaxStringWidth(int count);
 	GLuint getStringWidth(const std::string& text);
 	float getStringWidthf(const std::string& text);
-	GLshort getKerning(FT_UInt left, FT_UInt right);
+
+	/**
+	 * Retrieve the kerning adjustment for a pair of characters from the precomputed table.
+	 * Characters outside of the loaded range are never kerned.
+	 * @param left The left character in the kerning pair
+	 * @param right The right character in the kerning pair
+	 * @return The normalized x adjustment for this pair; it may be positive or negative
+	 */
+	GLshort getKerning(uint32_t left, uint32_t right) const {
+		if (left < FIRST_CHAR || left >= LAST_CHAR || right < FIRST_CHAR || right >= LAST_CHAR)
+			return 0;
+		return _kern[left - FIRST_CHAR][right - FIRST_CHAR];
+	}
+
+	/**
+	 * Check whether any pair of loaded characters is kerned, so that layout loops can skip
+	 * the lookup entirely for fonts without kerning
+	 * @return True if getKerning() may return a non-zero value
+	 */
+	bool hasKerning(void) const { return _kerning; }
 
 	/**
 	 * Return the font ID used by the manager to refer to this font
@@ -78,17 +202,46 @@ public:
 	int getId(void) const { return _id; }
 
 	/**
-	 * Return the texture id that serves as a handle to the opengl texture
-	 * @return OpenGL Texture ID for this font atlas
+	 * Return the texture id that serves as a handle to the opengl texture, which is the
+	 * same for every font sharing the atlas
+	 * @return OpenGL Texture ID for the glyph atlas
 	 */
-	GLuint getTextureId(void) const { return _texture; }
+	GLuint getTextureId(void) const { return _atlas->getTexture(); }
+
+	/**
+	 * Check whether this font's glyphs are signed distance fields, which must be drawn with
+	 * a shader that thresholds them rather than one that uses them as coverage
+	 * @return True if the glyphs are distance fields
+	 */
+	bool isDistanceField(void) const { return _distanceField; }
+
+	/**
+	 * Retrieve the atlas that this font's glyphs are packed into, to check its size and occupancy
+	 * @return The glyph atlas
+	 */
+	const GlyphAtlas *getAtlas(void) const { return _atlas; }
 	
+	const char_info *getCharInfo(uint32_t codepoint);
+	void evict(uint32_t codepoint, GlyphAtlas::Region& region);
+
 	/**
-	 * Get the char_info struct for a specific character
-	 * @param c The character whose info we need to look up
-	 * @return pointer to a character info struct for the character
+	 * Tells strings to lay themselves out again, because the atlas has made room for glyphs
+	 * that were drawn blank
 	 */
-	const char_info *getCharInfo(unsigned char c) const { return &_info[c]; }
+	void retryGlyphs(void) { _generation += 1; }
+
+	/**
+	 * Retrieve a counter that changes whenever cached glyphs are evicted or the atlas grows,
+	 * so that strings can tell when the texture coordinates they hold may no longer be valid
+	 * @return The current generation
+	 */
+	uint32_t getGeneration(void) const { return _source ? _source->getGeneration() : _generation + _atlas->getGeneration(); }
+
+	/**
+	 * Retrieve the number of glyphs currently held in the cache
+	 * @return Number of cached glyphs
+	 */
+	size_t getCachedGlyphCount(void) const { return _glyphs.size(); }
 
 	/**
 	 * Get the height of this font when drawn on screen, in normalized coordinates
@@ -111,8 +264,30 @@ public:
 	 */
 	GLshort getMaxDescender(void) const { return _maxDescender; }
 
+	/**
+	 * Get the room left around each glyph quad for its distance field, which is added above
+	 * and below the texture height, and is already part of each glyph's width and offset
+	 * @return The padding in normalized coordinates, zero for bitmap fonts
+	 */
+	GLshort getPadding(void) const { return _padding; }
+
 public:
-	static Font *loadFont(int id, gui2d::Manager *manager, const std::string& path, int size, std::ostream& err);
+	static uint32_t decodeUTF8(const char *&c);
+	static void configureLibrary(FT_Library library);
+	static bool openFace(FT_Library library, const FontData& data, int size, FT_Face& face, std::ostream& err);
+	static bool renderGlyph(FT_Face face, uint32_t codepoint, bool distanceField, GlyphBitmap& glyph);
+	static bool rasterize(FT_Face face, bool distanceField, FaceRaster& raster, std::ostream& err);
+	static bool loadRaster(FT_Library library, const FontData& data, int size, bool distanceField, const std::string& cacheDir,
+							FaceRaster& raster, std::ostream& err);
+	static Font *loadFont(int id, gui2d::Manager *manager, GlyphAtlas *atlas, const FontData& data, int size, std::ostream& err,
+							bool distanceField = false);
+	static Font *loadFont(int id, gui2d::Manager *manager, GlyphAtlas *atlas, const FontData& data, int size,
+							const FaceRaster& raster, std::ostream& err, bool distanceField = false);
+	static Font *scaleFont(int id, Font *source, int size);
+
+private:
+	static Font *createFont(int id, gui2d::Manager *manager, GlyphAtlas *atlas, const FontData& data, int size,
+							const FaceRaster& raster, std::ostream& err, bool distanceField);
 };
 
 };
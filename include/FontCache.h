@@ -0,0 +1,72 @@
+#ifndef _GUI2D_FONT_CACHE_H_
+#define _GUI2D_FONT_CACHE_H_
+/**
+ * @class gui2d::FontCache
+ * Binary cache of rasterized fonts, so that later runs, or shipped builds that were baked
+ * ahead of time with tools/fontbake, load fonts without running FreeType at all.
+ *
+ * Each file holds one Font::FaceRaster: the glyph bitmaps and metrics of the printable ASCII
+ * range and the kerning table. Files are named after a hash of the font file, the pixel size
+ * and whether the glyphs are distance fields, so edited fonts simply miss the cache. Glyphs
+ * are kept in pixels rather than as normalized char_info, which makes the cache independent
+ * of the screen resolution. Files are read through a memory mapping, and are written in the
+ * native byte order, since they are meant for the machine that produced them.
+ */
+
+// Standard headers
+#include <stdint.h>
+#include <string>
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+#include "2dgui/Font.h"
+#include "2dgui/MappedFile.h"
+
+namespace gui2d {
+
+class FontCache {
+public:
+	static const uint32_t VERSION = 1;		//!< Incremented whenever the file layout changes
+
+	/**
+	 * Start of every cache file
+	 */
+	struct Header {
+		char magic[4];			//!< Always "G2DF"
+		uint32_t version;		//!< Layout version, must match VERSION
+		uint64_t hash;			//!< Hash of the font file
+		int32_t size;			//!< Pixel size the glyphs were rasterized at
+		int32_t distanceField;	//!< Non-zero if the glyphs are distance fields
+		int32_t spread;			//!< Distance field spread, which must match Font::DISTANCE_SPREAD
+		int32_t glyphCount;		//!< Number of GlyphRecords following the header
+		int32_t kernCount;		//!< Number of kerning entries following the glyphs
+		int32_t maxAscent;		//!< Font::FaceRaster::maxAscent
+		int32_t minDescent;		//!< Font::FaceRaster::minDescent
+		int32_t maxWidth;		//!< Font::FaceRaster::maxWidth
+		uint64_t widths;		//!< Font::FaceRaster::widths
+		uint64_t pixelBytes;	//!< Size of the bitmaps following the kerning table
+	};
+
+	/**
+	 * One glyph, whose bitmap is stored with the others at the end of the file
+	 */
+	struct GlyphRecord {
+		uint32_t codepoint;
+		int32_t advance;
+		int32_t left, top;
+		int32_t width, rows;
+		int32_t ascent, descent;
+		uint64_t offset;		//!< Offset of the bitmap from the start of the bitmaps
+	};
+
+	static uint64_t hash(const unsigned char *data, size_t size);
+	static uint64_t hash(const MappedFile& file);
+	static std::string getName(uint64_t hash, int size, bool distanceField);
+	static bool read(const MappedFile& file, uint64_t hash, int size, bool distanceField, Font::FaceRaster& raster);
+	static bool write(const std::string& path, uint64_t hash, int size, bool distanceField, const Font::FaceRaster& raster);
+};
+
+};
+
+#endif
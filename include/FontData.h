@@ -0,0 +1,57 @@
+#ifndef _GUI2D_FONT_DATA_H_
+#define _GUI2D_FONT_DATA_H_
+/**
+ * @class gui2d::FontData
+ * Describes where a font face is loaded from: either a file, or a buffer that already holds
+ * the contents of one, such as a font inside a packed asset archive. The name identifies the
+ * font to the manager and in error messages, and is the path when there is no buffer.
+ *
+ * Buffers are not copied. FreeType reads from them for as long as any face is open, and
+ * fonts open faces lazily, so a buffer must stay valid until the manager is destroyed;
+ * Manager::mapFont() provides buffers whose lifetime the manager handles.
+ */
+
+// Standard headers
+#include <stddef.h>
+#include <string>
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+struct FontData {
+	std::string name;				//!< Path of the font file, or a name for the buffer
+	const unsigned char *data;		//!< Contents of the font file, or null to read the file at name
+	size_t size;					//!< Size of data, in bytes
+
+	/**
+	 * Describe no font at all, for fonts that do not open a face of their own
+	 */
+	FontData(void) : data(NULL), size(0) {}
+
+	/**
+	 * Describe a font file on disk
+	 * @param path Path to the font file
+	 */
+	FontData(const std::string& path) : name(path), data(NULL), size(0) {}
+
+	/**
+	 * Describe a font file on disk
+	 * @param path Path to the font file
+	 */
+	FontData(const char *path) : name(path), data(NULL), size(0) {}
+
+	/**
+	 * Describe a font held in memory
+	 * @param name Name that identifies the font, which must be unique for each buffer
+	 * @param data The contents of the font file, which must stay valid until the manager is destroyed
+	 * @param size Size of the buffer, in bytes
+	 */
+	FontData(const std::string& name, const void *data, size_t size) : name(name), data(static_cast<const unsigned char *>(data)), size(size) {}
+};
+
+};
+
+#endif
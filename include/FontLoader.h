@@ -0,0 +1,73 @@
+#ifndef _GUI2D_FONT_LOADER_H_
+#define _GUI2D_FONT_LOADER_H_
+/**
+ * @class gui2d::FontLoader
+ * Pool of worker threads that rasterize fonts in the background. Each worker owns its own
+ * FT_Library and opens its own faces, since FreeType objects may not be shared between
+ * threads, and produces a Font::FaceRaster in a single pass over the glyphs, or reads it
+ * from the font cache when there is one.
+ *
+ * Finished jobs are only collected by the thread that owns the GL context, which builds
+ * the Font from the raster and uploads it to the atlas. Jobs are identified by handles that
+ * the manager assigns when it submits them.
+ */
+
+// Standard headers
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+#include "2dgui/Font.h"
+
+namespace gui2d {
+
+class FontLoader {
+public:
+	/**
+	 * A font to rasterize, along with the result once a worker has finished with it
+	 */
+	struct Job {
+		int handle;					//!< Handle assigned by the manager
+		FontData data;				//!< The font file, or a buffer holding it
+		int size;					//!< Pixel size that was requested
+		bool distanceField;			//!< Rasterize distance fields at Font::DISTANCE_SIZE instead of size
+		std::string cacheDir;		//!< Directory of FontCache files to read and write, or empty
+		bool done;					//!< A worker has finished with the job
+		bool failed;				//!< The face or one of its glyphs could not be loaded
+		Font::FaceRaster raster;	//!< The rasterized glyphs
+		std::string error;			//!< Error messages written by the worker
+	};
+
+	typedef std::map<int, Job*> JobMap;		//!< Jobs that have not been taken, by handle
+
+private:
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _queued;		// Signalled when a job is submitted or the pool stops
+	std::condition_variable _finished;		// Signalled when a worker finishes a job
+	std::list<Job*> _queue;
+	JobMap _jobs;
+	bool _stopping;
+
+	void work(void);
+
+public:
+	FontLoader(int workers);
+	~FontLoader(void);
+
+	void submit(int handle, const FontData& data, int size, bool distanceField, const std::string& cacheDir);
+	bool isPending(int handle);
+	Job *take(int handle);
+	void getFinished(std::vector<int>& handles);
+};
+
+};
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef _GUI2D_GLYPH_ATLAS_H_
+#define _GUI2D_GLYPH_ATLAS_H_
+/**
+ * @class gui2d::GlyphAtlas
+ * Single channel texture that the glyph bitmaps of every font are packed into, so that text
+ * in any font can be drawn with the same texture bound. The atlas is a power of two square,
+ * grown ahead of time as fonts reserve room for the glyphs they expect, and doubled when it
+ * fills, up to the largest size the context supports.
+ *
+ * Regions are packed onto shelves: horizontal strips as tall as the first region placed on
+ * them, each tracking the free spans along its width. Released regions return their span
+ * to the shelf, so that glyphs of a similar height can reuse it. A shelf that is entirely
+ * empty may also be reused by shorter glyphs.
+ *
+ * Allocated regions are kept in least recently used order across all fonts. Once the atlas
+ * cannot grow, the oldest regions are evicted, and the font that owns each one is told to
+ * drop it from its cache.
+ *
+ * Strings copy their texture coordinates at different points of a frame, so neither growing
+ * nor evicting may happen in the middle of one. An allocation that does not fit is recorded
+ * and fails instead, and update() makes room for it at the start of the next frame, before
+ * anything is copied, evicting no more than MAX_EVICTIONS regions per frame. Only regions
+ * on shelves that could take the request are evicted, and never those used in the frame that
+ * asked, since the string that asked may be using them. The font that asked is then told to
+ * retry, so its strings lay themselves out again.
+ *
+ * Regions are written into a CPU copy of the atlas, and flush() uploads what changed with a
+ * single call per modified shelf, or the entire atlas at once after it was created or grown.
+ * Growing keeps every region at the same pixel position, but changes the normalized texture
+ * coordinates of all of them; the generation counter is incremented when that happens.
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <vector>
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+class GlyphAtlas {
+public:
+	static const int MAX_SIZE = 2048;			//!< Largest width and height of the atlas, if the context allows it
+	static const int MIN_SIZE = 64;				//!< Smallest width and height of the atlas
+	static const int HEADROOM = 2;				//!< Factor of spare area reserved beyond the initial estimate
+	static const int PADDING = 1;				//!< Empty pixels kept to the right of and below each region
+	static const int MAX_EVICTIONS = 32;		//!< Most regions that update() evicts in one frame
+
+	typedef std::map<int, int> SpanMap;			//!< Free spans of a shelf, from x offset to width
+
+	/**
+	 * The glyph that an allocated region holds
+	 */
+	struct Owner {
+		Font *font;				//!< Font that cached the glyph
+		uint32_t codepoint;		//!< Codepoint of the glyph within the font
+		int shelf;				//!< Shelf holding the glyph's region
+		uint32_t frame;			//!< Frame in which the glyph was last used
+	};
+
+	typedef std::list<Owner> OwnerLRU;			//!< Owners of allocated regions, most recently used first
+
+	/**
+	 * A horizontal strip of the atlas that holds regions of up to its height
+	 */
+	struct Shelf {
+		int y;				//!< Top row of the shelf
+		int height;			//!< Height of the shelf, including padding
+		SpanMap free;		//!< Unused spans along the shelf
+		int dirtyMin;		//!< First modified column, or -1 if the shelf is clean
+		int dirtyMax;		//!< One past the last modified column
+	};
+
+	/**
+	 * A rectangle allocated within the atlas, in pixels, excluding padding
+	 */
+	struct Region {
+		int shelf;			//!< Shelf holding the region
+		int x, y;			//!< Top left corner
+		int width, height;	//!< Size of the usable area
+		OwnerLRU::iterator lru;	//!< Position of the region in the recently used list
+	};
+
+	/**
+	 * An allocation that did not fit, which update() makes room for
+	 */
+	struct Request {
+		Font *font;			//!< Font that asked for the region
+		int width, height;	//!< Size of the region, excluding padding
+	};
+
+private:
+	GLuint _texture;
+	int _size;					// Width and height of the atlas
+	int _maxSize;				// Largest size the atlas may grow to
+	GLubyte *_pixels;			// CPU copy of the atlas contents
+	std::vector<Shelf> _shelves;
+	int _shelfTop;				// First row below the last shelf
+	size_t _usedArea;			// Area of allocated regions, including padding
+	OwnerLRU _lru;
+	std::vector<Request> _requests;	// Allocations that failed since the last update()
+	uint32_t _generation;
+	uint32_t _frame;			// Number of calls to update(), which stamps each use of a region
+	bool _resized;				// The texture storage must be (re)specified on the next flush
+
+	SpanMap::iterator findSpan(Shelf& shelf, int width);
+	bool place(int width, int height, Region& region);
+	bool hasRoom(int width, int height);
+	bool canReclaim(int shelf, int height, bool preferred) const;
+	bool evictFor(int width, int height, int& evictions);
+	void releaseSpan(const Region& region);
+
+	/**
+	 * Check whether a shelf holds no regions at all
+	 * @param shelf The shelf to check
+	 * @return True if the whole width of the shelf is free
+	 */
+	bool isEmpty(const Shelf& shelf) const { return shelf.free.size() == 1 && shelf.free.begin()->second == _size; }
+
+public:
+	GlyphAtlas(GLint filter = GL_NEAREST);
+	~GlyphAtlas(void);
+
+	void reserve(size_t area, int minSize);
+	bool allocate(int width, int height, Font *font, uint32_t codepoint, Region& region);
+	void release(const Region& region);
+	void cancel(Font *font);
+	bool grow(void);
+	void update(void);
+
+	/**
+	 * Check whether a region could ever be allocated, if the atlas grew as large as allowed
+	 * and nothing else were in it
+	 * @param width Width of the region, in pixels
+	 * @param height Height of the region, in pixels
+	 * @return True if the region is not too large for the atlas
+	 */
+	bool fits(int width, int height) const { return width + PADDING <= _maxSize && height + PADDING <= _maxSize; }
+
+	/**
+	 * Marks a region as the most recently used, so that it is evicted last, and as used in
+	 * this frame, so that it is not evicted before the next one
+	 * @param region The region that was used
+	 */
+	void touch(const Region& region) {
+		_lru.splice(_lru.begin(), _lru, region.lru);
+		region.lru->frame = _frame;
+	}
+	void write(const Region& region, const GLubyte *bitmap, int pitch, int width, int rows, int top);
+	void flush(void);
+
+	/**
+	 * Retrieve the texture that holds the atlas
+	 * @return The OpenGL name of the GL_TEXTURE_2D
+	 */
+	GLuint getTexture(void) const { return _texture; }
+
+	/**
+	 * Retrieve the current width and height of the atlas, which is always the same
+	 * @return Size of the atlas, in pixels
+	 */
+	int getSize(void) const { return _size; }
+
+	/**
+	 * Retrieve the size that the atlas may grow to, limited by the context
+	 * @return Largest size of the atlas, in pixels
+	 */
+	int getMaxSize(void) const { return _maxSize; }
+
+	/**
+	 * Retrieve the number of times that the atlas has grown, which changes the normalized
+	 * texture coordinates of every region
+	 * @return The current generation
+	 */
+	uint32_t getGeneration(void) const { return _generation; }
+
+	/**
+	 * Retrieve the fraction of the atlas that is covered by allocated regions and their
+	 * padding, which can be used to tune its size
+	 * @return Occupancy between zero and one
+	 */
+	float getOccupancy(void) const { return static_cast<float>(_usedArea) / (static_cast<float>(_size) * _size); }
+};
+
+};
+
+#endif
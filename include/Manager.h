@@ -15,16 +15,20 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <stdint.h>
 #include <iostream>
 #include <string>
+#include <deque>
 #include <list>
 #include <map>
+#include <vector>
 
 // Project definitions
 #include "sks.h"
 #include "Singleton.h"
 #include "TRResource.h"
 #include "2dgui/gui2d.h"
+#include "2dgui/FontData.h"
 #include "input/Cursor.h"
 
 //! @todo Move these to a util package
@@ -49,9 +53,12 @@ public:
 	 */
 	enum DestructorStates {NONE, BUTTONS, INPUTS, STRINGS};
 
+	static const int MOUSE_SCRATCH = 16;	//!< Overlapping handlers that mouse events have room for up front
+
 private:
 	// General data
 	bool _init;
+	int _options;
 	DestructorStates _destructor;
 	FT_Library _ft;
 	int _nextFontId;
@@ -61,26 +68,45 @@ private:
 	TextureCounter _textures;
 	FontIdMap _fontIds;
 	FontMap _fonts;
+	DistanceFontMap _distanceFonts;
+
+	// Fonts being rasterized in the background
+	FontLoader *_fontLoader;
+	FontHandleMap _fontHandles;		// Finished loads that finishFont() has not returned yet
+	FontWaitMap _fontWaits;			// Loads whose glyphs are still being rasterized
+	FontJobMap _fontJobs;			// Jobs in flight, so that loads of the same glyphs share one
+	int _nextFontHandle;
+	std::string _fontCache;
+
+	// Archives that fonts were mapped from, which stay mapped as long as the fonts may read them
+	MappedFileMap _archives;
 	FontStringList _strings;
 	InputList _inputs;
 
-	// Shader information and attribute locations for text
+	// Text rendering, with every font's glyphs in one atlas so that all strings draw together
 	Shader *_textShader;
-	GLint _ts_in_vert;
-	GLint _ts_in_tex;
-	GLint _ts_tex;
-	GLint _ts_color;
-	GLint _ts_un_z;
+	GlyphAtlas *_glyphAtlas;
+	TextRenderer *_text;
+
+	// Distance field text, drawn from a separate linearly filtered atlas with its own shader
+	Shader *_distanceShader;
+	GlyphAtlas *_distanceAtlas;
+	TextRenderer *_distanceText;
 
 	// Quad rendering systems
 	Shader *_guiShader;
 	Shader *_untexShader;
 	QuadRenderer *_qr;
 	TexturedQuadRenderer *_tqr;
+	TextureAtlas *_atlas;
+	Shader *_unifiedShader;
+	UnifiedRenderer *_ur;
 
 	// Mouse event listeners
-	QuadTree<iMouseHandler> *_mouseHandlers;
-	QuadTree<iMouseMotionHandler> *_mouseMotionHandlers;
+	FlatQuadTree<iMouseHandler> *_mouseHandlers;
+	FlatQuadTree<iMouseMotionHandler> *_mouseMotionHandlers;
+	std::deque<std::vector<iMouseHandler *> > _mouseScratch;	// Handlers under the cursor, per nested event
+	int _mouseDepth;				// Mouse events currently being dispatched
 
 	// Screen configuration
 	GraphicsEngine *_ge;
@@ -93,37 +119,54 @@ private:
 
 	// Render helpers for specific types of 2D elements
 	void renderText(void);
+	void renderUnified(void);
+
+	// Storage for the handlers under the cursor while dispatching a mouse event
+	std::vector<iMouseHandler *>& getMouseScratch(void);
+
+	Font *getDistanceFont(const FontData& data);
+	int addFont(const FontName& fname, Font *font);
+	void completeFont(int job);
+	static FontName getJobName(const FontName& fname);
 
 public:
 	Manager(GraphicsEngine *ge);
 	~Manager(void);
 
 	// Initializes the 2D GUI system
-	bool init(int screenWidth, int screenHeight, std::ostream& err);
+	bool init(int screenWidth, int screenHeight, std::ostream& err, int options = 0);
 
 	// Prepares the 2D GUI system for rendering
 	void prepare();
 
-	// Shader variable accessors
-	GLint getTSInVertLocation() const { return _ts_in_vert; }
-	GLint getTSInTexLocation() const { return _ts_in_tex; }
-	GLint getTSUniformTexLocation() const { return _ts_tex; }
-	GLint getTSUniformColorLocation() const { return _ts_color; }
-	GLint getTSUniformZLocation() const { return _ts_un_z; }
-
 	// Setup accessors
 	FT_Library *getFreeTypeLibrary(void) { return &_ft; }
 	int getScreenWidth(void) const { return _screenWidth; }
 	int getScreenHeight(void) const { return _screenHeight; }
+	int getOptions(void) const { return _options; }
+
+	/**
+	 * Set the directory that rasterized fonts are cached in, so that later runs can skip
+	 * FreeType; see FontCache. The directory must exist, and caching is off by default.
+	 * @param directory The directory to read and write cache files in, or empty to disable caching
+	 */
+	void setFontCache(const std::string& directory) { _fontCache = directory; }
+	const std::string& getFontCache(void) const { return _fontCache; }
 
 	// Font storage and retrieval interface
-	int loadFont(const std::string& path, int size);
-	int getFontId(const std::string& path, int size);
+	int loadFont(const FontData& data, int size, bool distanceField = false);
+	int getFontId(const FontData& data, int size, bool distanceField = false);
+	int loadFontAsync(const FontData& data, int size, bool distanceField = false);
+	bool mapFont(const std::string& archive, size_t offset, size_t length, FontData& data);
+	int finishFont(int handle, bool wait = true);
+	void finishFonts(void);
 	int getCurrentFontId(void) const { return _curFont; }
 	Font *getCurrentFont(void) { return _fonts[_curFont]; }
 	Font *getFont(int fontId);
 	void setFont(int fontId);
 	void setColor(glm::vec4 color) { _curColor = color; }
+	void setTextOutline(float width, glm::vec4 color);
+	void setTextShadow(glm::vec2 offset, glm::vec4 color);
 
 	// String management interface
 	String *createString(const std::string& source);
@@ -160,6 +203,11 @@ public:
 	// Single entry point for drawing all of the 2D subsystem
 	void render(void);
 
+	// Per-frame rendering statistics
+	size_t getQuadBytesUploaded(void) const;
+	uint32_t getQuadDrawCalls(void) const;
+	uint32_t getTextDrawCalls(void) const;
+
 	/**
 	 * Helper method that returns a height of one pixel normalized to our window height
 	 * Note that for a screen height of 800, valid pixel coordinates are -400,399, so 1/800
@@ -0,0 +1,64 @@
+#ifndef _GUI2D_MAPPED_FILE_H_
+#define _GUI2D_MAPPED_FILE_H_
+/**
+ * @class gui2d::MappedFile
+ * Read-only memory mapping of an entire file, which stays valid until the file is closed or
+ * the object is destroyed. Mappings cannot be copied.
+ */
+
+// Standard headers
+#include <stddef.h>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+class MappedFile {
+private:
+	const unsigned char *_data;
+	size_t _size;
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#endif
+
+	// Not copyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile(void);
+	~MappedFile(void);
+
+	bool open(const std::string& path);
+	void close(void);
+
+	/**
+	 * Check whether a file is currently mapped
+	 * @return True if the data is valid
+	 */
+	bool isOpen(void) const { return _data != NULL; }
+
+	/**
+	 * Retrieve the contents of the file
+	 * @return Pointer to the first byte, or null if no file is mapped
+	 */
+	const unsigned char *getData(void) const { return _data; }
+
+	/**
+	 * Retrieve the size of the file
+	 * @return Size of the mapping, in bytes
+	 */
+	size_t getSize(void) const { return _size; }
+};
+
+};
+
+#endif
@@ -23,17 +23,27 @@ namespace gui2d {
 class QuadRenderer : public QuadRendererBase<QuadRenderer, iUntexturedQuadRenderable>,
 						public Singleton<QuadRenderer> {
 private:
-	glm::u8vec4 *_vColors;		// Coloring is possible on a per-vertex basis
+	glm::u8vec4 *_vColors;		// Coloring is possible on a per-vertex basis, or per-quad when instanced
 	GLuint _colorVBO;			// OpenGL Vertex Buffer Objects used to store vertices, colors, and indices
+	GLint _s_color;				// Shader attribute location for vertex colors
 
 public:
 	QuadRenderer(Shader *s);
 	~QuadRenderer(void);
 
-	void resizeBuffers(uint16_t quads);
-	bool renderItem(RenderableIter& iter, uint16_t offset);
-	void updateBuffers(void);
+	void resizeBuffers(uint32_t quads);
+	void bindAttributes(GLuint vertexBuffer, GLuint colorBuffer, GLintptr colorOffset);
+	void bindBufferAttributes(void);
+	bool renderItem(RenderableIter& iter, uint32_t offset, bool force);
+	void streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset);
+	void reserveBuffers(uint32_t quads);
+	size_t updateBuffers(uint32_t first, uint32_t quads);
 	void drawElements(void);
+
+	/**
+	 * @return Size of the attributes stored alongside the coordinates for each quad, in bytes
+	 */
+	size_t getAttribSize(void) const { return (_instanced ? 1 : 4)*sizeof(glm::u8vec4); }
 };
 
 };
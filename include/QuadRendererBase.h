@@ -6,6 +6,25 @@
  * attempts to unify as much as possible and use CRTP-style programming to expose
  * hooks to allow specific quad renderer types to make small adjustments to the
  * overall rendering algorithm
+ *
+ * Quads can reach the GPU two ways. By default, renderables copy into staging arrays and
+ * modified ranges are pushed with glBufferSubData. When streaming is enabled, every frame
+ * is instead written straight into the next region of a persistently mapped StreamBuffer,
+ * laid out as all vertex regions followed by all attribute regions, so that one base vertex
+ * selects the same region in both streams.
+ *
+ * Each renderable is given a stable slot, a range of quads that it keeps until it is hidden,
+ * so showing or hiding one renderable never moves any other. Freed slots are zeroed, which
+ * draws them as degenerate triangles, and are reused first-fit by later renderables. The
+ * slots can optionally be compacted a few moves per frame to shrink the drawn range.
+ *
+ * Indices are stored as 16-bit values while every vertex in the staging arrays can be
+ * addressed that way, which is the common case. Once the arrays grow past that, the index
+ * buffer is rebuilt with 32-bit values, so a renderer is limited only by memory.
+ *
+ * When instancing is enabled, each quad is stored as a single record instead: its bottom
+ * left and top right corners, plus whatever per-quad attributes the derived class uses.
+ * The vertex shader expands the four corners from gl_VertexID, so no index buffer is used.
  */
 
 // Standard headers
@@ -13,11 +32,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_precision.hpp>
 #include <stdint.h>
-#include <set>
+#include <algorithm>
+#include <map>
+#include <vector>
 
 // Project definitions
 #include "sks.h"
 #include "Shader.h"
+#include "2dgui/StreamBuffer.h"
 
 namespace gui2d {
 
@@ -28,22 +50,80 @@ namespace gui2d {
 template <typename T, typename U>
 class QuadRendererBase {
 public:
-	typedef std::set<U*> RenderableSet;							//! Set of quad renderable instances to draw
+	typedef std::map<uint32_t, U*> RenderableSet;				//! Quad renderables to draw, keyed by slot offset
 	typedef typename RenderableSet::iterator RenderableIter;	//! Iterator for the set of renderables
 
+	/**
+	 * The range of quads assigned to a single renderable
+	 */
+	struct Slot {
+		uint32_t offset;	//!< First quad of the slot
+		uint16_t quads;		//!< Number of quads in the slot
+	};
+
+	typedef std::map<U*, Slot> SlotMap;						//! Slot assigned to each visible renderable
+	typedef typename SlotMap::iterator SlotIter;			//! Iterator for the slot assignments
+	typedef std::map<uint32_t, uint32_t> FreeList;			//! Free ranges below the high water mark, offset to length
+	typedef typename FreeList::iterator FreeIter;			//! Iterator for the free ranges
+
+	/**
+	 * A contiguous range of quads whose data must be pushed to the GPU this frame
+	 */
+	struct DirtyRange {
+		uint32_t first;		//!< First quad in the range
+		uint32_t count;		//!< Number of quads in the range
+
+		/**
+		 * Ranges are ordered by their first quad so that they can be coalesced
+		 */
+		bool operator<(const DirtyRange& other) const { return first < other.first; }
+	};
+
+	/**
+	 * Dirty ranges separated by no more than this many clean quads are merged into a single
+	 * upload, because a few redundant bytes are cheaper than another glBufferSubData call
+	 */
+	static const uint32_t DIRTY_MERGE_GAP = 8;
+
+	/**
+	 * Largest number of quads whose vertices can all be addressed with 16-bit indices
+	 */
+	static const uint32_t MAX_SHORT_INDEX_QUADS = 16384;
+
 protected:
-	uint16_t _bufferSize;		//! Size of arrays as allocated in memory
-	uint16_t _count;			//! Number of quads that we are going to draw
+	uint32_t _bufferSize;		//! Size of arrays as allocated in memory
+	uint32_t _gpuSize;			//! Size of the buffers as allocated on the GPU, in quads
+	uint32_t _count;			//! Number of quads that we are going to draw, the slot high water mark
+	uint16_t _compactMoves;		//! Number of renderables compaction may move per frame
 	bool _updateIndex;			//! Flag indicating whether or not to re-push the index buffer
+	bool _forceCopy;			//! Flag indicating that the staging arrays must be refilled from scratch
+	bool _instanced;			//! Flag indicating that quads are drawn as instances of one strip
+	uint16_t _quadVerts;		//! Number of entries in _vCoords per quad, 4 normally or 2 instanced
+	size_t _bytesUploaded;		//! Number of bytes pushed to the GPU during the last render() call
+	uint32_t _drawCalls;		//! Number of draw calls issued during the last render() call
+
+	std::vector<DirtyRange> _dirty;	//! Ranges of quads modified during this frame
 	
 	glm::i16vec3 *_vCoords;		//! Coordinates are stored as x, y, z, but z is constant for a quad
-	GLushort *_index;			//! Index buffers are used to reduce the memory requirements
+	GLubyte *_index;			//! Index buffers are used to reduce the memory requirements
+	GLenum _indexType;			//! Type of the values in _index, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	size_t _indexSize;			//! Size of one value in _index, in bytes
 	
 	GLuint _vao;				//! OpenGL Vertex Array Object that is used for all quads
 	GLuint _vbo[2];				//! OpenGL Vertex Buffer Objects used to store index and vertex data
 	Shader *_shader;			//! Shader that is used to draw
 
+	StreamBuffer *_stream;		//! Persistently mapped ring used in streaming mode, or null
+	GLint _baseVertex;			//! Base vertex of the region being drawn this frame
+	GLuint _baseInstance;		//! Base instance of the region being drawn this frame, when instanced
+
+	GLint _s_vert;				//! Shader attribute location for vertex coordinates, or the first corner
+	GLint _s_vertMax;			//! Shader attribute location for the opposite corner of instanced quads
+	GLint _gs_instanced;		//! Shader uniform location for the instancing flag
+
 	RenderableSet _drawItems;	// List of quad renderables that we should draw each frame
+	SlotMap _slots;				// Slot assigned to each renderable in _drawItems
+	FreeList _freeSlots;		// Unused ranges of quads below _count
 
 public:
 	/**
@@ -51,8 +131,13 @@ public:
 	 * to initialize additional VBOs and bind all VBOs to shader locations
 	 * @param s The shader to use to draw these quads
 	 */
-	QuadRendererBase(Shader *s) : _vCoords(0), _index(0), _shader(s), _bufferSize(0), _count(0),
-			_updateIndex(false), _vao(0) {
+	QuadRendererBase(Shader *s) : _vCoords(0), _index(0), _indexType(GL_UNSIGNED_SHORT), _indexSize(sizeof(GLushort)), _shader(s),
+			_bufferSize(0), _gpuSize(0), _count(0), _compactMoves(0), _updateIndex(false), _forceCopy(false), _instanced(false), _quadVerts(4), _bytesUploaded(0), _drawCalls(0), _vao(0),
+			_stream(0), _baseVertex(0), _baseInstance(0) {
+		_s_vert = s->getAttribLocation("in_vert");
+		_s_vertMax = s->getAttribLocation("in_vert_max");
+		_gs_instanced = s->getUniformLocation("un_instanced");
+
 		// Create buffers
 		glGenVertexArrays(1, &_vao);
 		glBindVertexArray(_vao);
@@ -73,6 +158,7 @@ public:
 		glDeleteBuffers(2, _vbo);
 		glBindVertexArray(0);
 		glDeleteVertexArrays(1, &_vao);
+		delete _stream;
 
 		if (_bufferSize > 0) {
 			free(_vCoords);
@@ -81,85 +167,528 @@ public:
 	}
 
 	/**
-	 * Adds the quad renderable to the drawing set
+	 * Switches this renderer to write quads directly into a persistently mapped ring buffer
+	 * each frame, rather than re-uploading staging arrays
+	 * @return True if streaming is now enabled, false if the context does not support it
+	 */
+	bool enableStreaming(void) {
+		if (_stream)
+			return true;
+
+		if (!StreamBuffer::isSupported())
+			return false;
+
+		_stream = new StreamBuffer();
+		_gpuSize = 0;
+		return true;
+	}
+
+	/**
+	 * Check whether this renderer is streaming through a persistently mapped buffer
+	 * @return True if streaming mode is active
+	 */
+	bool isStreaming(void) const { return _stream != 0; }
+
+	/**
+	 * Switches this renderer to upload one record per quad and draw each quad as an instance
+	 * of a four vertex strip. Drawing from an offset needs a base instance, which requires
+	 * ARB_base_instance.
+	 * @return True if instancing is now enabled, false if the context does not support it
+	 */
+	bool enableInstancing(void) {
+		if (_instanced)
+			return true;
+
+		if (!(GLEW_ARB_base_instance || GLEW_VERSION_4_2))
+			return false;
+
+		_instanced = true;
+		_quadVerts = 2;
+
+		// The staging arrays have a new layout, so they are resized and refilled from scratch
+		if (_bufferSize > 0) {
+			_vCoords = static_cast<glm::i16vec3 *>(realloc(_vCoords, _bufferSize*_quadVerts*sizeof(glm::i16vec3)));
+			static_cast<T*>(this)->resizeBuffers(_bufferSize);
+		}
+		_forceCopy = true;
+		_gpuSize = 0;
+		if (!_stream)
+			static_cast<T*>(this)->bindBufferAttributes();
+		return true;
+	}
+
+	/**
+	 * Check whether this renderer draws quads as instances
+	 * @return True if instanced mode is active
+	 */
+	bool isInstanced(void) const { return _instanced; }
+
+	/**
+	 * @return Size of the vertex coordinates stored for each quad, in bytes
+	 */
+	size_t getVertexSize(void) const { return _quadVerts*sizeof(glm::i16vec3); }
+
+	/**
+	 * Points the coordinate attributes at a vertex buffer. In instanced mode, the two corners
+	 * of a quad are read once per instance instead of once per vertex. The vertex array object
+	 * must already be bound.
+	 * @param vertexBuffer The buffer holding vertex coordinates, starting at offset zero
+	 */
+	void bindVertexAttributes(GLuint vertexBuffer) {
+		GLsizei stride = _instanced ? getVertexSize() : sizeof(glm::i16vec3);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glVertexAttribPointer(_s_vert, 3, GL_SHORT, GL_TRUE, stride, 0);
+		glEnableVertexAttribArray(_s_vert);
+
+		if (_instanced) {
+			glVertexAttribDivisor(_s_vert, 1);
+			glVertexAttribPointer(_s_vertMax, 2, GL_SHORT, GL_TRUE, stride,
+									reinterpret_cast<GLvoid *>(sizeof(glm::i16vec3)));
+			glVertexAttribDivisor(_s_vertMax, 1);
+			glEnableVertexAttribArray(_s_vertMax);
+		}
+	}
+
+	/**
+	 * Adds the quad renderable to the drawing set, giving it a slot of its own
 	 * @param r The Renderable to start drawing
 	 */
 	void show(U *r) {
-		std::pair<RenderableIter, bool> result = _drawItems.insert(r);
-		if (result.second) {
-			_count += r->getQuadCount();
-			ensureCapacity(_count);
-		}
+		Slot slot;
+
+		// Renderables without quads have nothing to draw and would share a slot offset
+		if (_slots.count(r) == 1 || r->getQuadCount() == 0)
+			return;
+
+		slot.quads = r->getQuadCount();
+		slot.offset = allocateSlot(slot.quads);
+		_slots[r] = slot;
+		_drawItems[slot.offset] = r;
+
+		// The slot may hold stale or zeroed data, so make sure the renderable copies itself in
+		r->invalidate();
 	}
 
 	/**
-	 * Removes the quad renderable from the drawing set.
+	 * Removes the quad renderable from the drawing set and frees its slot. No other
+	 * renderable is moved.
 	 * @param r The Renderable to remove
 	 */
 	void hide(U *r) {
-		size_t count = _drawItems.erase(r);
-		if (count == 1)
-			_count -= r->getQuadCount();
+		SlotIter iter = _slots.find(r);
+
+		if (iter == _slots.end())
+			return;
+
+		_drawItems.erase(iter->second.offset);
+		releaseSlot(iter->second.offset, iter->second.quads);
+		_slots.erase(iter);
+	}
+
+	/**
+	 * Finds room for a number of quads, reusing the first free range that is large enough
+	 * before growing the drawn range
+	 * @param quads The number of quads needed
+	 * @return The offset of the first quad of the new slot
+	 */
+	uint32_t allocateSlot(uint16_t quads) {
+		FreeIter iter;
+		uint32_t offset;
+
+		for (iter = _freeSlots.begin(); iter != _freeSlots.end(); ++iter) {
+			if (iter->second >= quads) {
+				offset = iter->first;
+				if (iter->second > quads)
+					_freeSlots[offset + quads] = iter->second - quads;
+				_freeSlots.erase(iter);
+				return offset;
+			}
+		}
+
+		offset = _count;
+		_count += quads;
+		ensureCapacity(_count);
+		return offset;
+	}
+
+	/**
+	 * Returns a range of quads to the free list, merging it with its neighbors. Freed quads
+	 * are zeroed so that they draw nothing, unless they are at the end of the drawn range,
+	 * in which case the drawn range simply shrinks.
+	 * @param offset The first quad of the range
+	 * @param quads The number of quads in the range
+	 */
+	void releaseSlot(uint32_t offset, uint32_t quads) {
+		FreeIter next, prev;
+
+		if (quads == 0)
+			return;
+
+		// Shrink the drawn range, absorbing any free range that now touches its end
+		if (offset + quads == _count) {
+			_count = offset;
+			if (!_freeSlots.empty()) {
+				prev = --_freeSlots.end();
+				if (prev->first + prev->second == _count) {
+					_count = prev->first;
+					_freeSlots.erase(prev);
+				}
+			}
+			return;
+		}
+
+		// Degenerate quads are not rasterized
+		std::fill(&_vCoords[_quadVerts*offset], &_vCoords[_quadVerts*(offset + quads)], glm::i16vec3(0));
+		markDirty(offset, quads);
+
+		// Merge with the following free range
+		next = _freeSlots.find(offset + quads);
+		if (next != _freeSlots.end()) {
+			quads += next->second;
+			_freeSlots.erase(next);
+		}
+
+		// Merge with the preceding free range
+		next = _freeSlots.lower_bound(offset);
+		if (next != _freeSlots.begin()) {
+			prev = next;
+			--prev;
+			if (prev->first + prev->second == offset) {
+				prev->second += quads;
+				return;
+			}
+		}
+
+		_freeSlots[offset] = quads;
+	}
+
+	/**
+	 * Moves renderables from the end of the drawn range into earlier free ranges, so that
+	 * fewer degenerate quads are drawn. Each move costs one copy of the moved renderable.
+	 * @param maxMoves The maximum number of renderables to move
+	 * @return The number of renderables that were moved
+	 */
+	uint16_t compact(uint16_t maxMoves) {
+		uint16_t moves = 0;
+		FreeIter hole;
+		RenderableIter last;
+		U *r;
+		Slot slot;
+
+		while (moves < maxMoves && !_freeSlots.empty() && !_drawItems.empty()) {
+			last = --_drawItems.end();
+			r = last->second;
+			slot = _slots[r];
+
+			// Find an earlier hole that fits the last renderable
+			for (hole = _freeSlots.begin(); hole != _freeSlots.end(); ++hole) {
+				if (hole->first < slot.offset && hole->second >= slot.quads)
+					break;
+			}
+			if (hole == _freeSlots.end())
+				break;
+
+			_drawItems.erase(last);
+			releaseSlot(slot.offset, slot.quads);
+			slot.offset = allocateSlot(slot.quads);
+			_slots[r] = slot;
+			_drawItems[slot.offset] = r;
+			moves += 1;
+
+			// Not every renderable tracks its previous offset, so the new slot must be refilled
+			r->invalidate();
+		}
+
+		return moves;
+	}
+
+	/**
+	 * Configure background compaction, which runs at the start of every render() call
+	 * @param movesPerFrame Maximum renderables to move per frame, or zero to disable compaction
+	 */
+	void setCompaction(uint16_t movesPerFrame) { _compactMoves = movesPerFrame; }
+
+	/**
+	 * Writes the six indices that draw one quad as two triangles
+	 * @tparam I The index type currently in use
+	 * @param quad The quad whose vertices are referenced
+	 * @param index The position in the index array to write to, in quads
+	 */
+	template <typename I>
+	void setQuadIndices(uint32_t quad, uint32_t index) {
+		I *dest = reinterpret_cast<I *>(_index) + 6*index;
+		dest[0] = 4*quad;
+		dest[1] = 4*quad + 2;
+		dest[2] = 4*quad + 3;
+		dest[3] = 4*quad;
+		dest[4] = 4*quad + 1;
+		dest[5] = 4*quad + 2;
+	}
+
+	/**
+	 * Writes the six indices for one quad in the index type currently in use
+	 * @param quad The quad whose vertices are referenced
+	 * @param index The position in the index array to write to, in quads
+	 */
+	void setIndex(uint32_t quad, uint32_t index) {
+		if (_indexType == GL_UNSIGNED_SHORT)
+			setQuadIndices<GLushort>(quad, index);
+		else
+			setQuadIndices<GLuint>(quad, index);
+	}
+
+	/**
+	 * Writes indices for a range of quads in the index type currently in use
+	 * @param first The first quad to write
+	 * @param last One past the last quad to write
+	 */
+	void fillIndices(uint32_t first, uint32_t last) {
+		uint32_t i;
+
+		if (_indexType == GL_UNSIGNED_SHORT) {
+			for (i = first; i < last; ++i)
+				setQuadIndices<GLushort>(i, i);
+		}
+		else {
+			for (i = first; i < last; ++i)
+				setQuadIndices<GLuint>(i, i);
+		}
 	}
 
 	/**
 	 * Ensure that the coordinate arrays are large enough to handle a given number of
 	 * entries all at once, to limit the number of memory operations that must be
-	 * performed.
+	 * performed. The arrays grow geometrically, so that a steadily rising high water mark
+	 * does not reallocate and re-specify the GPU buffers every frame, but never past what
+	 * 16-bit indices can address unless that many quads are actually needed. Growing past
+	 * that switches the index buffer to 32-bit values.
 	 * @param quads The number of quads we need to be able to store
 	 */
-	void ensureCapacity(uint16_t quads) {
+	void ensureCapacity(uint32_t quads) {
+		uint32_t first = _bufferSize;
+		uint32_t limit;
+
 		if (quads > _bufferSize) {
+			limit = quads <= MAX_SHORT_INDEX_QUADS ? MAX_SHORT_INDEX_QUADS : UINT32_MAX;
+			quads = std::max(quads, std::min(2*_bufferSize, limit));
+
+			if (_indexType == GL_UNSIGNED_SHORT && quads > MAX_SHORT_INDEX_QUADS) {
+				_indexType = GL_UNSIGNED_INT;
+				_indexSize = sizeof(GLuint);
+				first = 0;
+			}
+
 			// Reallocate memory
-			_vCoords = static_cast<glm::i16vec3 *>(realloc(_vCoords, quads*4*sizeof(glm::i16vec3)));
-			_index = static_cast<GLushort *>(realloc(_index, quads*6*sizeof(GLushort)));
+			_vCoords = static_cast<glm::i16vec3 *>(realloc(_vCoords, quads*_quadVerts*sizeof(glm::i16vec3)));
+			_index = static_cast<GLubyte *>(realloc(_index, quads*6*_indexSize));
 			static_cast<T*>(this)->resizeBuffers(quads);
 
-			// Update indices for new values
-			for (uint16_t i = _bufferSize; i < quads; ++i) {
-				_index[6*i] = 4*i;
-				_index[6*i+1] = 4*i + 2;
-				_index[6*i+2] = 4*i + 3;
-				_index[6*i+3] = 4*i;
-				_index[6*i+4] = 4*i + 1;
-				_index[6*i+5] = 4*i + 2;
-			}
+			// Update indices for new values, or all of them if the index type changed
+			fillIndices(first, quads);
 
 			_bufferSize = quads;
 			_updateIndex = true;
 		}
 	}
 
+	/**
+	 * Retrieve the type of the values in the index buffer, for use in draw calls
+	 * @return GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	 */
+	GLenum getIndexType(void) const { return _indexType; }
+
+	/**
+	 * Records that a range of quads was rewritten in the staging arrays, merging it with the
+	 * previous range when they are adjacent. Ranges may be marked in any order.
+	 * @param first The first quad that was modified
+	 * @param count The number of quads that were modified
+	 */
+	void markDirty(uint32_t first, uint32_t count) {
+		if (count == 0)
+			return;
+
+		if (!_dirty.empty()) {
+			DirtyRange& last = _dirty.back();
+			if (first >= last.first && first <= last.first + last.count + DIRTY_MERGE_GAP) {
+				last.count = std::max(last.count, first + count - last.first);
+				return;
+			}
+		}
+
+		DirtyRange range;
+		range.first = first;
+		range.count = count;
+		_dirty.push_back(range);
+	}
+
+	/**
+	 * Sorts the dirty ranges and merges those that overlap or are close together. Ranges past
+	 * the end of the drawn range are dropped, since they will not be drawn.
+	 */
+	void coalesceDirty(void) {
+		typename std::vector<DirtyRange>::iterator iter;
+		std::vector<DirtyRange> ranges;
+		uint32_t end;
+
+		std::sort(_dirty.begin(), _dirty.end());
+		ranges.swap(_dirty);
+
+		for (iter = ranges.begin(); iter != ranges.end(); ++iter) {
+			if (iter->first >= _count)
+				break;
+			end = std::min(iter->first + iter->count, _count);
+			markDirty(iter->first, end - iter->first);
+		}
+	}
+
+	/**
+	 * Pushes the dirty ranges recorded this frame to the GPU. If the staging arrays have grown
+	 * past what the GPU buffers can hold, the buffers are re-specified at the new size and the
+	 * entire visible range is uploaded once instead.
+	 */
+	void uploadDirty(void) {
+		typename std::vector<DirtyRange>::iterator iter;
+
+		if (_gpuSize < _bufferSize) {
+			glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
+			glBufferData(GL_ARRAY_BUFFER, _bufferSize*getVertexSize(), 0, GL_DYNAMIC_DRAW);
+			static_cast<T*>(this)->reserveBuffers(_bufferSize);
+			_gpuSize = _bufferSize;
+
+			_dirty.clear();
+			markDirty(0, _count);
+		}
+		else {
+			coalesceDirty();
+		}
+
+		for (iter = _dirty.begin(); iter != _dirty.end(); ++iter) {
+			glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
+			glBufferSubData(GL_ARRAY_BUFFER, iter->first*getVertexSize(), iter->count*getVertexSize(),
+							&_vCoords[_quadVerts*iter->first]);
+			_bytesUploaded += iter->count*getVertexSize();
+			_bytesUploaded += static_cast<T*>(this)->updateBuffers(iter->first, iter->count);
+		}
+	}
+
+	/**
+	 * (Re)creates the streaming ring so that each region can hold the full staging capacity,
+	 * and points the vertex attributes at it. If the ring cannot be created, streaming is
+	 * turned off and the ordinary buffers are used from now on.
+	 */
+	void allocateStream(void) {
+		size_t attribSize = static_cast<T*>(this)->getAttribSize();
+		GLsizeiptr vertexBytes = StreamBuffer::REGIONS*_bufferSize*getVertexSize();
+
+		if (_stream->allocate(vertexBytes + StreamBuffer::REGIONS*_bufferSize*attribSize)) {
+			static_cast<T*>(this)->bindAttributes(_stream->getBuffer(), _stream->getBuffer(), vertexBytes);
+			_gpuSize = _bufferSize;
+		}
+		else {
+			// The staging arrays were bypassed while streaming, so they must be rebuilt
+			delete _stream;
+			_stream = 0;
+			_gpuSize = 0;
+			_forceCopy = true;
+			static_cast<T*>(this)->bindBufferAttributes();
+		}
+	}
+
+	/**
+	 * Writes every visible renderable into the next region of the streaming ring. Regions
+	 * are reused every few frames, so each one must be rewritten in full.
+	 */
+	void streamItems(void) {
+		RenderableIter iter;
+		FreeIter hole;
+		GLubyte *base;
+		glm::i16vec3 *vCoords;
+		GLubyte *attribs;
+		int region;
+
+		if (_bufferSize == 0)
+			return;
+
+		if (_gpuSize < _bufferSize) {
+			allocateStream();
+			if (!_stream)
+				return;
+		}
+
+		region = _stream->nextRegion();
+		_baseVertex = region*_gpuSize*4;
+		_baseInstance = region*_gpuSize;
+
+		base = _stream->getPointer();
+		vCoords = reinterpret_cast<glm::i16vec3 *>(base) + region*_gpuSize*_quadVerts;
+		attribs = base + StreamBuffer::REGIONS*_gpuSize*getVertexSize() +
+					region*_gpuSize*static_cast<T*>(this)->getAttribSize();
+
+		for (iter = _drawItems.begin(); iter != _drawItems.end(); ++iter) {
+			static_cast<T*>(this)->streamItem(iter, vCoords, attribs, iter->first);
+		}
+
+		// Free slots still hold whatever was written to this region a few frames ago
+		for (hole = _freeSlots.begin(); hole != _freeSlots.end(); ++hole) {
+			std::fill(&vCoords[_quadVerts*hole->first], &vCoords[_quadVerts*(hole->first + hole->second)], glm::i16vec3(0));
+		}
+
+		_bytesUploaded += _count*(getVertexSize() + static_cast<T*>(this)->getAttribSize());
+	}
+
 	/**
 	 * To render, we iterate over the visible quads, update their information in our
-	 * buffer if necessary, and then draw them.
+	 * buffer if necessary, and then push only the modified ranges before drawing them.
+	 * In streaming mode they are instead written straight into the next ring region.
 	 */
 	void render(void) {
-		bool updateVBO = false;
-		uint16_t offset = 0;
 		RenderableIter iter;
 	
 		// Activate our shader program before doing anything else
 		_shader->use();
+		glUniform1i(_gs_instanced, _instanced);
 		glBindVertexArray(_vao);
+		_bytesUploaded = 0;
+		_drawCalls = 0;
 
-		// Iterate over our tracked renderables and ask them for state updates
-		for (iter = _drawItems.begin(); iter != _drawItems.end(); ++iter) {
-			updateVBO = static_cast<T*>(this)->renderItem(iter, offset) || updateVBO;
-			offset += (*iter)->getQuadCount();
+		if (_compactMoves > 0) {
+			compact(_compactMoves);
 		}
 
-		// Update GPU memory as appropriate
-		if (updateVBO) {
-			glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
-			glBufferData(GL_ARRAY_BUFFER, _count*sizeof(glm::i16vec3)*4, _vCoords, GL_DYNAMIC_DRAW);
-			static_cast<T*>(this)->updateBuffers();
+		if (_stream) {
+			streamItems();
+		}
+
+		if (!_stream) {
+			_baseVertex = 0;
+			_baseInstance = 0;
+
+			// Iterate over our tracked renderables and ask them for state updates
+			for (iter = _drawItems.begin(); iter != _drawItems.end(); ++iter) {
+				if (static_cast<T*>(this)->renderItem(iter, iter->first, _forceCopy))
+					markDirty(iter->first, _slots[iter->second].quads);
+			}
+
+			// Free slots were never copied into if the staging arrays are being rebuilt
+			if (_forceCopy) {
+				markDirty(0, _count);
+				_forceCopy = false;
+			}
+
+			// Update GPU memory as appropriate
+			if (!_dirty.empty() || _gpuSize < _bufferSize) {
+				uploadDirty();
+			}
 		}
+		_dirty.clear();
 
-		// Index buffers are reloaded separately
-		if (_updateIndex) {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[2]);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, _count*sizeof(GLushort)*6, _index, GL_DYNAMIC_DRAW);
+		// Index buffers are reloaded separately, and are not used at all when instancing
+		if (_updateIndex && !_instanced) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, _bufferSize*_indexSize*6, _index, GL_DYNAMIC_DRAW);
+			_bytesUploaded += _bufferSize*_indexSize*6;
+			_updateIndex = false;
 		}
 
 		// Draw the elements indexed if we have any visible
@@ -167,10 +696,34 @@ public:
 			static_cast<T*>(this)->drawElements();
 		}
 
+		// Keep the region we just drew from until the GPU is finished with it
+		if (_stream) {
+			_stream->fence();
+		}
+
 		glBindVertexArray(0);
 		glUseProgram(0);
 	}
 
+	/**
+	 * Retrieve the number of bytes of vertex, attribute, and index data that were pushed to
+	 * the GPU during the most recent call to render()
+	 * @return Bytes uploaded in the last frame
+	 */
+	size_t getBytesUploaded(void) const { return _bytesUploaded; }
+
+	/**
+	 * Retrieve the renderables that are currently visible, keyed by slot offset
+	 * @return The drawing set
+	 */
+	const RenderableSet& getRenderables(void) const { return _drawItems; }
+
+	/**
+	 * Retrieve the number of draw calls issued during the most recent call to render()
+	 * @return Draw calls in the last frame
+	 */
+	uint32_t getDrawCalls(void) const { return _drawCalls; }
+
 };
 
 };
@@ -30,6 +30,11 @@ private:
 	static const int QUAD_TBORDER = 3;		///< Quad number for the top border
 	static const int QUAD_BBORDER = 4;		///< Quad number for the bottom border
 
+	// Widths of the numeric fields, in characters
+	static const int FPS_SLOTS = 7;			///< Slots for the frame rate, with one decimal place
+	static const int COUNT_SLOTS = 10;		///< Slots for the primitive and sample counts
+	static const int TIME_SLOTS = 9;		///< Slots for times, with two decimal places
+
 	// Important pointers and configuration
 	GraphicsEngine *_ge;
 	Manager *_m;
@@ -0,0 +1,67 @@
+#ifndef _GUI2D_STREAM_BUFFER_H_
+#define _GUI2D_STREAM_BUFFER_H_
+/**
+ * @class gui2d::StreamBuffer
+ * A persistently mapped OpenGL buffer that is split into several regions which are written
+ * round-robin, one per frame. Each region is protected by a fence so that the CPU never
+ * overwrites data that the GPU has not finished reading. This requires ARB_buffer_storage;
+ * callers should check isSupported() and fall back to ordinary buffer objects otherwise.
+ */
+
+// Standard headers
+#include <gl/glew.h>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+class StreamBuffer {
+public:
+	/**
+	 * Number of regions in the ring. Three lets the CPU fill one frame while the GPU
+	 * reads another and the driver holds a third in its queue.
+	 */
+	static const int REGIONS = 3;
+
+private:
+	GLuint _buffer;				//!< OpenGL buffer object name
+	GLubyte *_mapped;			//!< Persistent mapping of the entire buffer
+	GLsizeiptr _size;			//!< Total size of the buffer, in bytes
+	GLsync _fences[REGIONS];	//!< Fences guarding each region against reuse
+	int _region;				//!< Region currently being written
+
+	void release(void);
+
+public:
+	StreamBuffer(void);
+	~StreamBuffer(void);
+
+	bool allocate(GLsizeiptr size);
+	int nextRegion(void);
+	void fence(void);
+
+	/**
+	 * Retrieve the opengl name of the buffer, for binding vertex attributes
+	 * @return Buffer object name, or 0 if nothing is allocated
+	 */
+	GLuint getBuffer(void) const { return _buffer; }
+
+	/**
+	 * Retrieve the client pointer to the start of the mapped storage
+	 * @return Pointer to the mapped buffer
+	 */
+	GLubyte *getPointer(void) const { return _mapped; }
+
+	/**
+	 * Retrieve the region currently being written
+	 * @return Region index, between 0 and REGIONS-1
+	 */
+	int getRegion(void) const { return _region; }
+
+	static bool isSupported(void);
+};
+
+};
+
+#endif
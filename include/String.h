@@ -1,9 +1,24 @@
 #ifndef _2DGUI_STRING_H_
 #define _2DGUI_STRING_H_
 /**
- * A visible string that is displayed on screen
+ * A visible string that is displayed on screen. The text is UTF-8, and offsets used for
+ * editing it are byte offsets. Glyph quads are laid out relative to the start of the string,
+ * which is only added when they are copied into a batch, so moving a string does not lay it
+ * out again unless that changes where it is clipped. The relative layout is kept in 32 bits,
+ * since a string may span the whole screen, and positions are only narrowed once the start
+ * has been added.
+ *
+ * A string may end in a numeric field instead: a run of fixed width slots after its text,
+ * each holding one character of a number. Setting the number formats it without allocating
+ * and redraws only the slots whose character changed, which suits counters that are updated
+ * every frame. Editing the text turns the field back into ordinary text.
+ *
+ * Strings may also be wrapped into lines no wider than a maximum width, breaking after
+ * spaces and at newlines, with each line aligned within that width. The first line sits at
+ * the string's position and later lines go down from it. The line breaks are cached, so an
+ * edit only breaks the text again from the line before the edited word, until a line starts
+ * at the same text as before; the lines after that are moved rather than laid out again.
  * TODO: Implement the minimum bounding box for a centralized window around the string
- * TODO: Implement optional word wrapping
  */
 
 // Standard headers
@@ -11,7 +26,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_precision.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 // Project definitions
 #include "2dgui/Font.h"
@@ -21,17 +38,41 @@
 
 namespace gui2d {
 
+/**
+ * Per-vertex attributes of a glyph quad, as written for the batched text renderer
+ */
+struct GlyphAttrib {
+	glm::u16vec2 tex;	//!< Normalized texture coordinates within the font texture
+	glm::u8vec4 color;	//!< Color of the string, including its opacity
+};
+
 class String : public iZOrderable, public iTransparent, public iVisible {
+public:
+	static const int MAX_FIELD_SLOTS = 24;	//!< Most slots that a numeric field may have
+
+	/**
+	 * One line of wrapped text
+	 */
+	struct Line {
+		int start;			//!< Byte offset of the first character on the line
+		int end;			//!< Byte offset after the last character drawn on the line
+		int quad;			//!< First quad drawn on the line
+		GLint width;		//!< Width of the line's characters, before it is aligned
+	};
+
+	typedef std::vector<Line> LineList;		//!< Lines of wrapped text, in order
+
 private:
 	//
 	std::string _source;
-	bool _init, _gInit, _modified;
+	bool _init, _modified;
+	bool _moved;					// Only the start has changed since the last render()
 	Font *_font;
 
 	// Coordinates
 	float _x, _y;					// Start of the string
 	GLshort _startX, _startY;		// Start of string, normalized
-	GLshort _curX, _curY;			// End of the string, normalized
+	GLint _curX;					// End of the string, relative to its start
 
 	// Bounds for where we are allowed to draw our string (should not emit vertices greater than these)
 	GLint _bMinX;
@@ -40,30 +81,66 @@ private:
 	GLint _bMaxY;
 
 	// Buffers to copy to GPU
-	glm::i16vec2* _vertcoords;
+	glm::i32vec2* _vertcoords;		// Glyph quads, relative to the start
 	glm::u16vec2* _texcoords;
 	glm::vec4 _color;
-	GLushort* _index;
+
+	// Layout of each character, indexed by the byte offset that it starts at, so that edits
+	// only lay out the characters next to them and move the rest; wrapped text uses lines instead
+	GLint *_pens;					// Pen x before each character, and after the last one laid out
+	uint16_t *_quadStarts;			// First quad drawn at or after each character
+	int _laidOut;					// Bytes laid out before the bounds stopped drawing
 
 	// Array size counters
 	int _strLen;
 	int _maxCount;
 	int _vertexCount;
-	int _indexCount;
-	
-	// opengl buffer identifiers
-	GLuint _vao;
-	GLuint _vbo[2];
-	GLuint _ibo;
+	uint32_t _glyphGeneration;		// Font generation when the string was last laid out in full
+
+	// Range of quads that an edit changed since the last render()
+	int _dirtyFirst, _dirtyEnd;
+
+	// Numeric field drawn after the text, whose characters follow it in _source
+	int _fieldPrefix;				// Length of the text before the field, in bytes
+	int _fieldSlots;				// Number of slots, or zero if the string has no field
+	int _fieldQuad;					// Quad of the first slot
+	GLint _fieldPen;				// Pen at the first slot, relative to the start
+	GLint _fieldAdvance;			// Width of every slot
+
+	// Word wrapping, which is off while the width is zero
+	GLint _wrapWidth;				// Widest that a line may be
+	GLint _lineHeight;				// Distance between the tops of successive lines
+	int _align;						// TEXT_ALIGN_* constant to align each line with
+	LineList _lines;				// Cached line breaks, only used while wrapping
+	LineList _oldLines;				// Line breaks from before an edit, kept to reuse their storage
 
 	// Drawing and management helper methods
-	void drawChar(const Font::char_info& ci, GLshort curX, GLshort curY, int indexOffset, int vertexOffset);
+	void drawChar(const Font::char_info& ci, GLint curX, GLint curY, int vertexOffset);
 	bool hasCapacity(int count);
-	void increaseCapacity(int minCapacity, int copyCount);
-	void findPen(const std::string& source);
-	void findPenDraw(const std::string& source);
+	void increaseCapacity(int minCapacity);
+	uint32_t getPrevious(int offset);
+	int countQuads(const std::string& source);
+	bool layout(int start, int end);
+	void relayout(void);
+	void splice(int start, int removed, const std::string& inserted);
+	void touch(int first, int end);
+	void layoutField(void);
+	void drawSlot(int slot, char c);
+	void setFieldText(const char *text, int length);
+	static int formatInteger(unsigned long value, char *text);
+	int breakLine(Line& line, int& quads);
+	GLint alignLine(const Line& line) const;
+	void drawLine(int line);
+	void layoutLines(int first);
+	void spliceLines(int start, int removed, const std::string& inserted);
 	void init(void);
 
+	/**
+	 * Check whether the text is currently wrapped, which numeric fields never are
+	 * @return True if the string is laid out in lines
+	 */
+	bool isWrapped(void) const { return _wrapWidth > 0 && _fieldSlots == 0; }
+
 public:
 	String(Font* font);
 	virtual ~String(void);
@@ -72,15 +149,21 @@ public:
 	int length(void) const { return _source.length(); }
 	Font* getFont(void) const { return _font; }
 	int getVertexCount(void) const { return _vertexCount; }
-	int getIndexCount(void) const { return _indexCount; }
 	const std::string& getText(void) const { return _source; }
+	glm::i16vec2 getPosition(int vertex) const;
+	const glm::u16vec2* getTexData(void) const { return _texcoords; }
+	const glm::vec4& getColor(void) const { return _color; }
 
 	// Text adjustment
 	void drawText(const std::string& source, float normX, float normY);
 	void drawText(const std::string& source);
 	String& translate(float normX, float normY);
 	String& setPosition(float normX, float normY);
-	String& setColor(const glm::vec4& color) { _color = color; return *this; }
+	String& setColor(const glm::vec4& color) { _color = color; _modified = true; return *this; }
+
+	// Update the z index, which is stored per vertex
+	using iZOrderable::setZ;
+	virtual void setZ(GLushort z);
 
 	// Update the opacity
 	void setOpacity(float alpha);
@@ -91,8 +174,8 @@ public:
 	void setMinY(float minY);
 	void setMaxX(float maxX);
 	void setMaxY(float maxY);
-	float getWidthf(void) const { return _font->getStringWidthf(_source); }
-	float getHeightf(void) const { return _font->getHeight(); }
+	float getWidthf(void) const;
+	float getHeightf(void) const;
 	float getX(void) const { return _x; }
 	float getY(void) const { return _y; }
 
@@ -102,9 +185,36 @@ public:
 	void remove(int start, int length);
 	void insert(const std::string& source, int start);
 
+	// Word wrapping
+	String& setWrap(float maxWidth, int align = TEXT_ALIGN_LEFT, float lineHeight = 0.0f);
+
+	/**
+	 * Retrieve the number of lines that the text was wrapped into
+	 * @return The number of lines, which is always one if the string is not wrapped
+	 */
+	int getLineCount(void) const { return isWrapped() ? static_cast<int>(_lines.size()) : 1; }
+
+	// Numeric fields
+	void drawField(const std::string& prefix, int slots);
+	void setField(long value);
+	void setField(double value, int decimals);
+
 	// Rendering
-	void graphicsInit(void);
-	void render(void);
+	/**
+	 * Retrieve the number of glyph quads reserved for this string, which is its character
+	 * capacity; quads past the drawn glyphs are written as degenerate triangles
+	 * @return Number of quads to give this string in a batch
+	 */
+	uint16_t getQuadCount(void) const { return static_cast<uint16_t>(_maxCount); }
+
+	/**
+	 * Forces the next call to render() to copy all of this string's data
+	 */
+	void invalidate(void) { _modified = true; }
+
+	void refresh(void);
+	bool render(glm::i16vec3 *vCoords, GlyphAttrib *attribs, uint32_t offset, bool force, uint32_t& first, uint32_t& count,
+				bool& positionsOnly);
 };
 
 };
@@ -0,0 +1,88 @@
+#ifndef _TEXT_RENDERER_H_
+#define _TEXT_RENDERER_H_
+/**
+ * @class gui2d::TextRenderer
+ * Draws every visible string in a single call, whatever its font. All fonts pack their
+ * glyphs into one shared atlas, and the glyph quads of all of the strings are kept in one
+ * shared buffer, with color and z stored per vertex, so that no per-string or per-font
+ * state has to be set between draws.
+ *
+ * Strings do not tell the renderer when they are shown or hidden, so the manager's lists
+ * of strings are checked at the start of each frame, and each string is given a slot
+ * sized to its character capacity. A string only moves to a new slot when it is shown or
+ * its capacity grows. Text is never drawn instanced.
+ *
+ * Each renderer only draws strings whose font uses its atlas, so distance field fonts, which
+ * need their own atlas and shader, are drawn by a second renderer. Its shader may apply an
+ * outline and a drop shadow to every string; the uniforms are simply ignored otherwise.
+ *
+ * Strings that only moved rewrite their vertex coordinates but not their attributes, so the
+ * attribute ranges that changed are tracked apart from the vertex ranges that the base
+ * class uploads, and only those are pushed to the attribute buffer.
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <stdint.h>
+#include <vector>
+
+// Project definitions
+#include "sks.h"
+#include "2dgui/gui2d.h"
+#include "2dgui/QuadRendererBase.h"
+#include "2dgui/String.h"
+
+namespace gui2d {
+
+class TextRenderer : public QuadRendererBase<TextRenderer, String> {
+private:
+	GlyphAtlas *_glyphAtlas;	// Atlas holding the glyphs of every font
+	FontStringList *_strings;	// Every string of every font, visible or not
+	GlyphAttrib *_attribs;		// Texture coordinates and colors for each vertex
+	GLuint _attribVBO;			// OpenGL Vertex Buffer Object used to store the attributes
+	std::vector<DirtyRange> _attribDirty;	// Ranges of quads whose attributes changed this frame
+	bool _attribAll;			// The attribute buffer was re-specified, so all of it must be uploaded
+	GLint _s_tex;				// Shader attribute location for texture coordinates
+	GLint _s_color;				// Shader attribute location for vertex colors
+	GLint _gs_tex;				// Shader uniform location for the font texture
+	GLint _gs_outlineWidth;		// Shader uniform locations for the distance field effects
+	GLint _gs_outlineColor;
+	GLint _gs_shadowOffset;
+	GLint _gs_shadowColor;
+
+	// Distance field effects
+	float _outlineWidth;
+	glm::vec4 _outlineColor;
+	glm::vec2 _shadowOffset;
+	glm::vec4 _shadowColor;
+
+	void updateSlots(void);
+
+public:
+	TextRenderer(Shader *s, GlyphAtlas *glyphAtlas, FontStringList *strings);
+	~TextRenderer(void);
+
+	void resizeBuffers(uint32_t quads);
+	void bindAttributes(GLuint vertexBuffer, GLuint attribBuffer, GLintptr attribOffset);
+	void bindBufferAttributes(void);
+	bool renderItem(RenderableIter& iter, uint32_t offset, bool force);
+	void streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset);
+	void reserveBuffers(uint32_t quads);
+	size_t updateBuffers(uint32_t first, uint32_t quads);
+	void drawElements(void);
+	void render(void);
+
+	void setOutline(float width, const glm::vec4& color);
+	void setShadow(const glm::vec2& offset, const glm::vec4& color);
+
+	/**
+	 * @return Size of the attributes stored alongside the coordinates for each quad, in bytes
+	 */
+	size_t getAttribSize(void) const { return 4*sizeof(GlyphAttrib); }
+};
+
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef _GUI2D_TEXTURE_ATLAS_H_
+#define _GUI2D_TEXTURE_ATLAS_H_
+/**
+ * @class gui2d::TextureAtlas
+ * Packs small UI images into shared atlas pages, so that quads using different images can
+ * still be drawn with a single texture bound. The pages are the layers of one array texture,
+ * so every atlased image can be drawn in the same call; the layer travels with the texture
+ * coordinates. Each page is packed with a skyline packer,
+ * which cannot reuse the space of removed images; instead, once enough of the packed area
+ * is dead, the atlas is defragmented by repacking every live image from its CPU copy. A
+ * repack re-uploads the whole atlas, so it is rate limited to once every few seconds.
+ *
+ * Images are identified by handles that share the GLuint space of texture names but have
+ * HANDLE_BIT set, so that renderables can hold either kind of id. Handles remain valid
+ * across defragmentation, but the page and texture coordinates they map to do not; the
+ * generation counter is incremented whenever anything moves.
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <stdint.h>
+#include <vector>
+
+// Project definitions
+#include "sks.h"
+#include "Singleton.h"
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+class TextureAtlas : public Singleton<TextureAtlas> {
+public:
+	static const GLuint HANDLE_BIT = 0x80000000;	//!< Set in every atlas handle, never in a real texture name
+	static const int PAGE_SIZE = 1024;				//!< Width and height of each atlas page, in pixels
+	static const int MAX_IMAGE_SIZE = 256;			//!< Images larger than this in either dimension get their own texture
+	static const int PADDING = 1;					//!< Border of replicated edge pixels around each image
+
+	/**
+	 * Fraction of a page's packed area that may belong to removed images before the atlas
+	 * is defragmented
+	 */
+	static const float DEFRAG_THRESHOLD;
+
+	/**
+	 * Dead area, in pixels, that a page must also have before it counts as fragmented, so
+	 * that removing a few small images never triggers a full repack
+	 */
+	static const uint32_t DEFRAG_MIN_AREA = PAGE_SIZE*PAGE_SIZE/8;
+
+	/**
+	 * Minimum number of update() calls between two defragmentations
+	 */
+	static const uint32_t DEFRAG_COOLDOWN = 120;
+
+	/**
+	 * Location of one image within the atlas
+	 */
+	struct Entry {
+		int page;			//!< Page holding the image, or -1 if the entry is unused
+		int x, y;			//!< Bottom left corner of the padded image within the page
+		int w, h;			//!< Size of the padded image
+		glm::u16vec4 uv;	//!< Normalized min U, min V, max U, max V of the unpadded image
+		GLubyte *pixels;	//!< CPU copy of the padded image, used for repacking
+	};
+
+	/**
+	 * One segment of a page's skyline, the top edge of everything packed below it
+	 */
+	struct SkylineNode {
+		int x;				//!< Leftmost pixel of the segment
+		int y;				//!< Height of the skyline along the segment
+		int width;			//!< Width of the segment
+	};
+
+	/**
+	 * A single layer of the array texture that images are packed into
+	 */
+	struct Page {
+		std::vector<SkylineNode> skyline;	//!< Packed outline, ordered by x
+		uint32_t packedArea;				//!< Area handed out since the page was last packed
+		uint32_t liveArea;					//!< Area of images still in use
+	};
+
+private:
+	GLuint _texture;			// Array texture holding every page as a layer
+	int _layers;				// Number of layers allocated in _texture
+	std::vector<Page> _pages;
+	std::vector<Entry> _entries;
+	std::vector<uint32_t> _freeEntries;
+	uint32_t _generation;
+	uint32_t _sinceDefrag;		// Number of update() calls since the last defragmentation
+	bool _fragmented;
+
+	int createPage(void);
+	void reserveLayers(int layers);
+	bool pack(Page& page, int w, int h, int& x, int& y);
+	bool fitsAt(const Page& page, size_t node, int w, int h, int& y) const;
+	bool place(Entry& entry);
+	void upload(const Entry& entry);
+
+public:
+	TextureAtlas(void);
+	~TextureAtlas(void);
+
+	GLuint add(const GLubyte *rgba, int w, int h);
+	void remove(GLuint handle);
+	void defragment(void);
+	void update(void);
+
+	const Entry& getEntry(GLuint handle) const;
+
+	/**
+	 * Retrieve the array texture that holds every atlas page
+	 * @return The OpenGL name of the GL_TEXTURE_2D_ARRAY
+	 */
+	GLuint getTexture(void) const { return _texture; }
+
+	/**
+	 * Retrieve the number of times that images have moved within the atlas, so that
+	 * users of cached texture coordinates can tell when to refresh them
+	 * @return The current generation
+	 */
+	uint32_t getGeneration(void) const { return _generation; }
+
+	/**
+	 * Retrieve the number of pages currently allocated
+	 * @return Number of atlas pages
+	 */
+	size_t getPageCount(void) const { return _pages.size(); }
+
+	/**
+	 * Check whether an image is small enough to be placed in the atlas
+	 * @param w Width of the image, in pixels
+	 * @param h Height of the image, in pixels
+	 * @return True if the image may be added
+	 */
+	static bool fits(int w, int h) { return w > 0 && h > 0 && w <= MAX_IMAGE_SIZE && h <= MAX_IMAGE_SIZE; }
+
+	/**
+	 * Check whether an id names an atlas image rather than a texture
+	 * @param id The texture name or atlas handle
+	 * @return True if the id is an atlas handle
+	 */
+	static bool isHandle(GLuint id) { return (id & HANDLE_BIT) != 0; }
+};
+
+};
+
+#endif
@@ -3,7 +3,8 @@
 /**
  * @class gui2d::TexturedQuadRenderer
  * This handles rendering textured quads, which use a different shader program
- * from untextured quads.
+ * from untextured quads. Quads are grouped into batches that share a texture, so that
+ * each texture is bound and drawn once per frame rather than once per quad.
  */
 
 // Standard headers
@@ -11,6 +12,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_precision.hpp>
 #include <stdint.h>
+#include <utility>
+#include <vector>
 
 // Project definitions
 #include "sks.h"
@@ -23,19 +26,50 @@ namespace gui2d {
 
 class TexturedQuadRenderer : public QuadRendererBase<TexturedQuadRenderer, iTexturedQuadRenderable>,
 								public Singleton<TexturedQuadRenderer> {
+public:
+	/**
+	 * A contiguous run of quads that are drawn with a single texture in one call
+	 */
+	struct Batch {
+		GLuint texture;		//!< Texture bound for the run
+		uint32_t first;		//!< First quad of the run in the index buffer, or first instance
+		uint32_t count;		//!< Number of quads in the run
+	};
+
+	typedef std::pair<GLuint, uint32_t> TexturedQuad;		//! Texture and slot offset of one visible quad
+
 private:
-	glm::u16vec3 *_tCoords;
+	std::vector<TexturedQuad> _quads;		// Visible quads gathered this frame
+	std::vector<TexturedQuad> _batchQuads;	// Visible quads that the current batches were built from
+	std::vector<Batch> _batches;			// Runs of quads to draw, one call each
+	uint32_t _batchBufferSize;				// Staging capacity when the batched indices were written
+
+	glm::u16vec4 *_tCoords;
 	GLuint _textureVBO;
+	GLint _s_tex;
+	GLint _s_texMax;
 	GLint _gs_tex;
+	GLint _gs_texArray;
+	GLint _gs_layered;
 
 public:
 	TexturedQuadRenderer(Shader *s);
 	~TexturedQuadRenderer(void);
 
-	void resizeBuffers(uint16_t quads);
-	bool renderItem(RenderableIter& iter, uint16_t offset);
-	void updateBuffers(void);
+	void resizeBuffers(uint32_t quads);
+	void bindAttributes(GLuint vertexBuffer, GLuint texBuffer, GLintptr texOffset);
+	void bindBufferAttributes(void);
+	bool renderItem(RenderableIter& iter, uint32_t offset, bool force);
+	void streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset);
+	void reserveBuffers(uint32_t quads);
+	size_t updateBuffers(uint32_t first, uint32_t quads);
+	void buildBatches(void);
 	void drawElements(void);
+
+	/**
+	 * @return Size of the attributes stored alongside the coordinates for each quad, in bytes
+	 */
+	size_t getAttribSize(void) const { return _quadVerts*sizeof(glm::u16vec4); }
 };
 
 };
@@ -0,0 +1,127 @@
+#ifndef _GUI2D_UNIFIED_RENDERER_H_
+#define _GUI2D_UNIFIED_RENDERER_H_
+/**
+ * @class gui2d::UnifiedRenderer
+ * Draws untextured quads, textured quads, and text glyphs together in a single pass with one
+ * shader. Every quad is written into one vertex stream with a per-vertex mode that selects
+ * how the fragment shader colors it, and the quads are sorted by z so that layering is correct
+ * between all types of elements, which the separate per-type passes cannot guarantee.
+ *
+ * Quads are drawn back to front and split into batches only where a different 2D texture
+ * must be bound. Untextured and atlased quads do not need one, since the atlas array lives on
+ * its own texture unit, so they join whichever batch they fall into.
+ *
+ * The stream is rebuilt from scratch every frame, which keeps this simple at the cost of the
+ * incremental uploads that the per-type renderers do; they remain available for comparison.
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <stdint.h>
+#include <vector>
+
+// Project definitions
+#include "sks.h"
+#include "Shader.h"
+#include "2dgui/gui2d.h"
+
+namespace gui2d {
+
+class UnifiedRenderer {
+public:
+	/**
+	 * How the fragment shader colors a vertex
+	 */
+	enum Mode {
+		MODE_COLOR = 0,		//!< Untextured, the vertex color is used
+		MODE_TEXTURE = 1,	//!< Sampled from the bound 2D texture, with alpha from the texture coordinates
+		MODE_ATLAS = 2,		//!< Sampled from the atlas array, with alpha and layer from the texture coordinates
+		MODE_GLYPH = 3,		//!< Vertex color, with coverage from the red channel of the bound 2D texture
+		MODE_DISTANCE = 4	//!< Vertex color, with coverage thresholded from a distance field in the bound 2D texture
+	};
+
+	/**
+	 * A single vertex in the unified stream
+	 */
+	struct Vertex {
+		glm::i16vec3 pos;	//!< Normalized position and z
+		GLushort mode;		//!< One of the Mode values
+		glm::u16vec4 tex;	//!< Normalized texture coordinates, alpha, and atlas layer
+		glm::u8vec4 color;	//!< Vertex color
+	};
+
+	/**
+	 * Sort key for one quad in the stream
+	 */
+	struct QuadKey {
+		GLint z;			//!< Z of the quad, larger values are further back
+		GLuint texture;		//!< 2D texture that must be bound, or 0 if any will do
+		uint32_t vertex;	//!< First of the quad's four vertices in the unsorted stream
+
+		/**
+		 * Quads are drawn back to front
+		 */
+		bool operator<(const QuadKey& other) const { return z > other.z; }
+	};
+
+	/**
+	 * A run of sorted quads that are drawn with a single call
+	 */
+	struct Batch {
+		GLuint texture;		//!< 2D texture bound for the run, or 0 if none is needed
+		uint32_t first;		//!< First quad of the run
+		uint32_t count;		//!< Number of quads in the run
+	};
+
+private:
+	Shader *_shader;
+	GLuint _vao;
+	GLuint _vbo[2];
+	uint32_t _indexQuads;			// Number of quads covered by the index buffer
+	size_t _bytesUploaded;
+	uint32_t _drawCalls;
+
+	GLint _s_vert;
+	GLint _s_mode;
+	GLint _s_tex;
+	GLint _s_color;
+	GLint _gs_tex;
+	GLint _gs_texArray;
+
+	std::vector<Vertex> _vertices;	// Quads in the order they were added
+	std::vector<Vertex> _sorted;	// Quads in drawing order
+	std::vector<QuadKey> _keys;
+	std::vector<Batch> _batches;
+
+	void addQuad(const Vertex *v, GLuint texture);
+	void buildBatches(void);
+	void ensureIndices(uint32_t quads);
+
+public:
+	UnifiedRenderer(Shader *s);
+	~UnifiedRenderer(void);
+
+	void begin(void);
+	void add(iUntexturedQuadRenderable *r);
+	void add(iTexturedQuadRenderable *r);
+	void add(String *s);
+	void render(void);
+
+	/**
+	 * Retrieve the number of bytes pushed to the GPU during the most recent call to render()
+	 * @return Bytes uploaded in the last frame
+	 */
+	size_t getBytesUploaded(void) const { return _bytesUploaded; }
+
+	/**
+	 * Retrieve the number of draw calls issued during the most recent call to render()
+	 * @return Draw calls in the last frame
+	 */
+	uint32_t getDrawCalls(void) const { return _drawCalls; }
+};
+
+};
+
+#endif
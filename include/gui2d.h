@@ -24,8 +24,17 @@ namespace gui2d {
 	template<typename T, typename U> class QuadRendererBase;
 	class QuadRenderer;
 	class TexturedQuadRenderer;
+	class TextRenderer;
+	class FontLoader;
+	class MappedFile;
+	struct FontData;
+	class StreamBuffer;
+	class TextureAtlas;
+	class GlyphAtlas;
+	class UnifiedRenderer;
 	class Statistics;
 	template<typename T> class QuadTree;
+	template<typename T> class FlatQuadTree;
 
 	// Interfaces and interface-like classes
 	class iQuadRenderable;
@@ -46,6 +55,15 @@ namespace gui2d {
 	const int SHADER_TEXT_SLOT = 2;			//!< ID used for the text shader
 	const int SHADER_2DGUI_SLOT = 3;		//!< ID used for the textured quad shader
 	const int SHADER_UNTEX_QUAD_SLOT = 4;	//!< ID used for the untextured quad shader
+	const int SHADER_UNIFIED_SLOT = 5;		//!< ID used for the unified quad and text shader
+	const int SHADER_TEXT_SDF_SLOT = 6;		//!< ID used for the distance field text shader
+
+	const int FONT_PENDING = -2;			//!< Font id reported for an asynchronous load that has not finished
+
+	// Renderer options that may be passed to Manager::init()
+	const int RENDER_STREAMING = 0x1;		//!< Stream quads through persistently mapped buffers when supported
+	const int RENDER_INSTANCED = 0x2;		//!< Upload one record per quad and draw quads as instances when supported
+	const int RENDER_UNIFIED = 0x4;			//!< Draw quads and text together in one z-sorted pass
 
 	// Text alignment constants
 	const int TEXT_ALIGN_LEFT = 1;			//!< Indicates that a displayed string should be left-aligned
@@ -61,6 +79,16 @@ namespace gui2d {
 
 	typedef std::map<int, Font*> FontMap;			//!< Mapping from manager-assigned id to font name
 	typedef FontMap::iterator FontMapIter;			//!< Iterator for font id->name map
+
+	typedef std::map<int, int> FontHandleMap;			//!< Mapping from asynchronous load handle to the font id it produced
+	typedef std::map<int, FontName> FontWaitMap;		//!< Mapping from asynchronous load handle to the font it is waiting for
+	typedef std::map<FontName, int> FontJobMap;			//!< Mapping from the glyphs a background job rasterizes to its handle
+
+	typedef std::map<std::string, MappedFile*> MappedFileMap;	//!< Mapping from path to an open file mapping
+	typedef MappedFileMap::iterator MappedFileMapIter;			//!< Iterator for path->file mapping map
+
+	typedef std::map<std::string, Font*> DistanceFontMap;	//!< Mapping from font name to the distance field glyphs for its face
+	typedef DistanceFontMap::iterator DistanceFontMapIter;	//!< Iterator for font name->distance field font map
 	
 	typedef std::map<int, StringList*> FontStringList;		//!< Mapping from font id to a list of strings using that font
 	typedef FontStringList::iterator FontStringListIter;	//!< Iterator for font id->list of strings map
@@ -4,9 +4,13 @@
  * @class gui2d::iMouseHandler
  * Interface/base class for all objects that wish to receive mouse events. Note that this implicitly
  * makes the class implement the MBR interface, so plan accordingly.
+ *
+ * Where handlers overlap, events go to the topmost one first, which is the one with the lowest
+ * z. Handlers that are z-orderable use their own z, and the rest are beneath everything else.
  */
 
 // Standard headers
+#include <gl/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_precision.hpp>
 #include <OIS/OIS.h>
@@ -14,6 +18,7 @@
 // Project definitions
 #include "2dgui/gui2d.h"
 #include "2dgui/iMBR.h"
+#include "2dgui/iZOrderable.h"
 
 namespace gui2d {
 
@@ -26,6 +31,15 @@ public:
 	iMouseHandler(const glm::vec4& bounds) : iMBR(bounds) {}
 	virtual ~iMouseHandler(void) {}
 
+	/**
+	 * Retrieve the key that overlapping handlers are ordered by, where the lowest is on top
+	 * @return The handler's z if it is z-orderable, otherwise the largest z
+	 */
+	virtual GLushort getMouseZ(void) const {
+		const iZOrderable *z = dynamic_cast<const iZOrderable *>(this);
+		return z ? z->getZ() : static_cast<GLushort>(0xFFFF);
+	}
+
 	/**
 	 * This method is called when a mouse pressed event is generated by OIS, from the manager
 	 * @param x X coordinate of mouse press, normalized
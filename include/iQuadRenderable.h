@@ -22,7 +22,7 @@ class iQuadRenderable {
 protected:
 	uint16_t _count;			//! Count of quads rendered
 
-	uint16_t _prevOffset;		//! Offset that we previously rendered to
+	uint32_t _prevOffset;		//! Offset that we previously rendered to
 	bool _modified;				//! Have the vertex or color data been modified?
 	
 	glm::i16vec3 *_vCoords;		//! Local copy of vertex coordinates
@@ -38,12 +38,24 @@ public:
 	void setQuadZ(uint16_t quad, GLshort z);
 	void setQuadPosition(uint16_t quad, const glm::i16vec3& coords, GLshort w, GLshort h);
 
-	bool render(glm::i16vec3 *vCoords, uint16_t offset, bool force);
+	bool render(glm::i16vec3 *vCoords, uint32_t offset, bool force);
+	bool renderInstance(glm::i16vec3 *corners, uint32_t offset, bool force);
 
 	/**
 	 * @return Number of quads this Renderable expects
 	 */
 	uint16_t getQuadCount(void) const { return _count; }
+
+	/**
+	 * @return Our local copy of the vertex coordinates, four per quad
+	 */
+	const glm::i16vec3 *getVertexData(void) const { return _vCoords; }
+
+	/**
+	 * Forces the next render() call to copy our data, for when the destination array no
+	 * longer holds it
+	 */
+	void invalidate(void) { _modified = true; }
 };
 
 };
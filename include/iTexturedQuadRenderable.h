@@ -5,6 +5,10 @@
  * This completes the quad renderable interface except requires quads to use textures to
  * do rendering. It is handled somewhat separately from the untextured quads but shares
  * core positioning code
+ *
+ * A quad's texture id may be an atlas handle instead of a texture name. Texture coordinates
+ * are always given relative to the image, and are mapped into the atlas page when they are
+ * copied to the renderer.
  */
 
 // Standard headers
@@ -22,7 +26,11 @@ namespace gui2d {
 class iTexturedQuadRenderable : public iQuadRenderable {
 private:
 	GLuint *_tId;
-	glm::u16vec3 *_tCoords;
+	glm::u16vec4 *_tCoords;
+	uint32_t _atlasGeneration;		//! Atlas generation that our mapped coordinates were copied for
+
+	glm::u16vec4 mapTexCoord(uint16_t quad, const glm::u16vec4& tc) const;
+	bool refreshAtlas(void);
 
 public:
 	iTexturedQuadRenderable(uint16_t quads);
@@ -33,21 +41,36 @@ public:
 	void setQuadAlpha(uint16_t quad, float alpha);
 	void setQuadAlpha(uint16_t quad, GLushort alpha);
 
-	bool render(glm::i16vec3 *vCoords, glm::u16vec3 *tCoords, int offset, bool force);
+	bool render(glm::i16vec3 *vCoords, glm::u16vec4 *tCoords, uint32_t offset, bool force);
+	bool renderInstance(glm::i16vec3 *corners, glm::u16vec4 *tCorners, uint32_t offset, bool force);
 
 	/**
 	 * Set the texture ID that should be used during rendering
 	 * @param quad Which quad to set the texture for
-	 * @param tId the new opengl texture id to use
+	 * @param tId the new opengl texture id or atlas handle to use
 	 */
-	void setTextureId(uint16_t quad, GLuint tId) { _tId[quad] = tId; }
+	void setTextureId(uint16_t quad, GLuint tId) {
+		_tId[quad] = tId;
+		_modified = true;
+	}
 
 	/**
-	 * Retrieves the texture ID for a specific quad, useful during rendering
-	 * @return The opengl id for a specific quad's texture
+	 * Retrieves the texture ID for a specific quad, as it was set
+	 * @return The opengl id or atlas handle for a specific quad's texture
 	 */
 	GLuint getTextureId(uint16_t quad) const { return _tId[quad]; }
 
+	GLuint getGLTextureId(uint16_t quad) const;
+
+	/**
+	 * Retrieves the texture coordinate of one corner of a quad, mapped into the texture that
+	 * is bound for it
+	 * @param quad The quad to look up
+	 * @param corner The corner, from 0 to 3
+	 * @return The mapped coordinate, with alpha in z and the atlas layer in w
+	 */
+	glm::u16vec4 getTexCoord(uint16_t quad, int corner) const { return mapTexCoord(quad, _tCoords[4*quad + corner]); }
+
 };
 
 };
@@ -34,7 +34,13 @@ public:
 	void setQuadAlpha(uint16_t quad, uint8_t alpha);
 	void setQuadAlpha(uint16_t quad, float alpha);
 
-	bool render(glm::i16vec3 *vCoords, glm::u8vec4 *vColors, uint16_t offset, bool force);
+	bool render(glm::i16vec3 *vCoords, glm::u8vec4 *vColors, uint32_t offset, bool force);
+	bool renderInstance(glm::i16vec3 *corners, glm::u8vec4 *colors, uint32_t offset, bool force);
+
+	/**
+	 * @return Our local copy of the vertex colors, four per quad
+	 */
+	const glm::u8vec4 *getColorData(void) const { return _vColors; }
 };
 
 };
@@ -67,6 +67,14 @@ public:
 		_setZ(z);
 	}
 
+	/**
+	 * Retrieve the current z value
+	 * @return The z value, as an unnormalized unsigned short
+	 */
+	GLushort getZ(void) const {
+		return _z;
+	}
+
 };
 
 };
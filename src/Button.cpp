@@ -133,6 +133,7 @@ void gui2d::Button::setOpacity(float alpha) {
  * @param z The new z-index to use
  */
 void gui2d::Button::setZ(float z) {
+	_setZ(static_cast<GLushort>(z));
 	setQuadZ(0, static_cast<GLshort>(z));
 	_str->setZ(z - 1.0f);
 }
@@ -10,132 +10,597 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 
 // Project definitions
 #include "2dgui/Font.h"
+#include "2dgui/FontCache.h"
+#include "2dgui/MappedFile.h"
 
 /**
- * Destructor will simply deallocate our texture memory, if it has been allocated
+ * Destructor closes the face if one was opened, and returns our glyphs' space to the shared atlas
  */
 gui2d::Font::~Font(void) {
-	if (_init) {
-		glDeleteTextures(1, &_texture);
+	GlyphMap::iterator iter;
+
+	if (!_atlas)
+		return;
+
+	if (_face)
+		FT_Done_Face(_face);
+
+	_atlas->cancel(this);
+	for (iter = _glyphs.begin(); iter != _glyphs.end(); ++iter) {
+		if (iter->second.region.shelf >= 0)
+			_atlas->release(iter->second.region);
 	}
 }
 
 /**
  * Factory constructor for Font objects. This should only be called by the Manager in order to
  * ensure consistent id assignments.
- * @todo Is it necessary to close the font face on failure?
  * @param id The id number assigned by the Manager
  * @param manager A pointer to the owning manager
- * @param path The path to the font in question
+ * @param atlas The glyph atlas shared by the manager's fonts, which must outlive the font
+ * @param data The font file, or a buffer holding one
  * @param size The pixel size to use for this font
  * @param err A stream to write error messages to
+ * @param distanceField Rasterize glyphs as signed distance fields, for use through scaleFont()
  * @return A pointer to the newly loaded Font instance
  */
-gui2d::Font *gui2d::Font::loadFont(int id, gui2d::Manager *manager, const std::string& path, int size, std::ostream& err) {
-	FT_Library *ft = manager->getFreeTypeLibrary();
-	FT_GlyphSlot g;
+gui2d::Font *gui2d::Font::loadFont(int id, gui2d::Manager *manager, gui2d::GlyphAtlas *atlas, const gui2d::FontData& data, int size, std::ostream& err,
+									bool distanceField) {
+	FaceRaster raster;
+
+	if (!loadRaster(*manager->getFreeTypeLibrary(), data, size, distanceField, manager->getFontCache(), raster, err))
+		return NULL;
+
+	return createFont(id, manager, atlas, data, size, raster, err, distanceField);
+}
+
+/**
+ * Factory constructor for Font objects whose printable ASCII range was already rasterized,
+ * usually by a FontLoader worker. The face is opened again on the manager's library if the
+ * font needs any other glyphs, since those are rasterized on the GL thread. This should only
+ * be called by the Manager in order to ensure consistent id assignments.
+ * @param id The id number assigned by the Manager
+ * @param manager A pointer to the owning manager
+ * @param atlas The glyph atlas shared by the manager's fonts, which must outlive the font
+ * @param data The font file, or a buffer holding one
+ * @param size The pixel size that the raster was produced at
+ * @param raster The measured and rendered glyphs
+ * @param err A stream to write error messages to
+ * @param distanceField Whether the raster holds signed distance fields
+ * @return A pointer to the newly loaded Font instance
+ */
+gui2d::Font *gui2d::Font::loadFont(int id, gui2d::Manager *manager, gui2d::GlyphAtlas *atlas, const gui2d::FontData& data, int size,
+									const FaceRaster& raster, std::ostream& err, bool distanceField) {
+	return createFont(id, manager, atlas, data, size, raster, err, distanceField);
+}
+
+/**
+ * Applies the library-wide settings that fonts rely on, which must be done for every
+ * FT_Library that faces are opened on
+ * @param library The library to configure
+ */
+void gui2d::Font::configureLibrary(FT_Library library) {
+#ifdef GUI2D_DISTANCE_FIELDS
+	int spread = DISTANCE_SPREAD;
+	FT_Property_Set(library, "sdf", "spread", &spread);
+#endif
+}
+
+/**
+ * Opens a face and sets its pixel size. Faces opened from a buffer read it for as long as
+ * they are open, so it is not copied.
+ * @param library The library to open the face with; the face may only be used on the thread that owns it
+ * @param data The font file, or a buffer holding one
+ * @param size The pixel size to set
+ * @param face Filled in with the opened face
+ * @param err A stream to write error messages to
+ * @return True if the face was opened
+ */
+bool gui2d::Font::openFace(FT_Library library, const gui2d::FontData& data, int size, FT_Face& face, std::ostream& err) {
+	FT_Error error;
+
+	if (data.data)
+		error = FT_New_Memory_Face(library, data.data, static_cast<FT_Long>(data.size), 0, &face);
+	else
+		error = FT_New_Face(library, data.name.c_str(), 0, &face);
+
+	if (error) {
+		err << "(gui2d::Font::loadFont()) Could not open font: " << data.name.c_str() << std::endl;
+		return false;
+	}
+
+	FT_Set_Pixel_Sizes(face, 0, size);
+	return true;
+}
+
+/**
+ * Renders one glyph and copies it out of the glyph slot. Codepoints that the face lacks are
+ * rendered as its missing glyph.
+ * @param face The face to render with, already sized, or null to produce a blank glyph
+ * @param codepoint The unicode codepoint to render
+ * @param distanceField Render a signed distance field rather than coverage
+ * @param glyph Filled in with the glyph, which is blank with no advance if it could not be loaded
+ * @return True if the glyph was loaded
+ */
+bool gui2d::Font::renderGlyph(FT_Face face, uint32_t codepoint, bool distanceField, gui2d::Font::GlyphBitmap& glyph) {
+	FT_GlyphSlot g = face->glyph;
+	int spread = distanceField ? DISTANCE_SPREAD : 0;
+	bool rendered = true;
+	int row;
+
+	glyph.codepoint = codepoint;
+	glyph.advance = 0;
+	glyph.left = glyph.top = 0;
+	glyph.width = glyph.rows = 0;
+	glyph.ascent = glyph.descent = 0;
+	glyph.pixels.clear();
+
+	if (!face || FT_Load_Char(face, codepoint, distanceField ? FT_LOAD_DEFAULT : FT_LOAD_RENDER))
+		return false;
+
+	// Blank glyphs have no outline to measure distances from, but still advance the pen
+#ifdef GUI2D_DISTANCE_FIELDS
+	if (distanceField)
+		rendered = !FT_Render_Glyph(g, FT_RENDER_MODE_SDF);
+#endif
+
+	glyph.advance = g->advance.x;
+	glyph.ascent = g->metrics.horiBearingY/64;
+	glyph.descent = glyph.ascent;
+	if (!rendered || g->bitmap.width == 0 || g->bitmap.rows == 0)
+		return true;
+
+	glyph.left = g->bitmap_left;
+	glyph.top = g->bitmap_top;
+	glyph.width = g->bitmap.width;
+	glyph.rows = g->bitmap.rows;
+	glyph.descent = glyph.ascent - std::max(glyph.rows - 2*spread, 0);
+
+	glyph.pixels.resize(glyph.width*glyph.rows);
+	for (row = 0; row < glyph.rows; ++row) {
+		memcpy(&glyph.pixels[row*glyph.width], &g->bitmap.buffer[row*g->bitmap.pitch], glyph.width);
+	}
+	return true;
+}
+
+/**
+ * Measures and renders the printable ASCII range of a face in a single pass, and reads its
+ * kerning table. Nothing here touches the GL context or the manager, so faces may be
+ * rasterized on any thread that owns their library.
+ * @param face The face to rasterize, already sized
+ * @param distanceField Render signed distance fields rather than coverage
+ * @param raster Filled in with the glyphs and their measurements
+ * @param err A stream to write error messages to
+ * @return True if every character was loaded
+ */
+bool gui2d::Font::rasterize(FT_Face face, bool distanceField, gui2d::Font::FaceRaster& raster, std::ostream& err) {
+	FT_UInt glyphs[CHAR_COUNT];
+	FT_Vector kern;
+	int left, right, i;
+
+#ifndef GUI2D_DISTANCE_FIELDS
+	if (distanceField) {
+		err << "(gui2d::Font::loadFont()) Distance field fonts need FreeType 2.11 or later" << std::endl;
+		return false;
+	}
+#endif
+
+	raster.glyphs.resize(CHAR_COUNT);
+	raster.maxAscent = 0;
+	raster.minDescent = 0;
+	raster.maxWidth = 0;
+	raster.widths = 0;
+
+	for (i = 0; i < CHAR_COUNT; ++i) {
+		GlyphBitmap& glyph = raster.glyphs[i];
+
+		if (!renderGlyph(face, i + FIRST_CHAR, distanceField, glyph)) {
+			err << "(gui2d::Font::loadFont()) Could not load character: " << static_cast<char>(i + FIRST_CHAR) << std::endl;
+			return false;
+		}
+
+		raster.maxWidth = std::max(raster.maxWidth, glyph.width);
+		raster.widths += glyph.width + GlyphAtlas::PADDING;
+		raster.maxAscent = std::max(raster.maxAscent, glyph.ascent);
+		raster.minDescent = std::min(raster.minDescent, glyph.descent);
+	}
+
+	// Kerning is looked up by glyph index, not by character code, and only the horizontal
+	// distance is kept
+	raster.kern.clear();
+	if (!FT_HAS_KERNING(face))
+		return true;
+
+	for (left = 0; left < CHAR_COUNT; ++left) {
+		glyphs[left] = FT_Get_Char_Index(face, left + FIRST_CHAR);
+	}
+
+	raster.kern.resize(CHAR_COUNT*CHAR_COUNT, 0);
+	for (left = 0; left < CHAR_COUNT; ++left) {
+		for (right = 0; right < CHAR_COUNT; ++right) {
+			if (!FT_Get_Kerning(face, glyphs[left], glyphs[right], FT_KERNING_DEFAULT, &kern))
+				raster.kern[left*CHAR_COUNT + right] = kern.x;
+		}
+	}
+	return true;
+}
+
+/**
+ * Produces the raster for a face, reading it from the font cache if there is a matching
+ * entry, and otherwise rasterizing the face and writing the result to the cache
+ * @param library The library to open the face with, if it must be rasterized
+ * @param data The font file, or a buffer holding one, which is hashed directly
+ * @param size The pixel size to rasterize at
+ * @param distanceField Render signed distance fields rather than coverage
+ * @param cacheDir Directory holding FontCache files, or empty to always rasterize
+ * @param raster Filled in with the glyphs and their measurements
+ * @param err A stream to write error messages to
+ * @return True if the raster was read or rasterized
+ */
+bool gui2d::Font::loadRaster(FT_Library library, const gui2d::FontData& data, int size, bool distanceField, const std::string& cacheDir,
+								gui2d::Font::FaceRaster& raster, std::ostream& err) {
+	MappedFile file;
+	MappedFile cache;
+	std::string cachePath;
+	uint64_t hash = 0;
+	FT_Face face;
+	bool loaded;
+
+	if (!cacheDir.empty()) {
+		if (data.data) {
+			hash = FontCache::hash(data.data, data.size);
+		}
+		else {
+			if (!file.open(data.name)) {
+				err << "(gui2d::Font::loadFont()) Could not open font: " << data.name.c_str() << std::endl;
+				return false;
+			}
+			hash = FontCache::hash(file);
+		}
+
+		cachePath = cacheDir + "/" + FontCache::getName(hash, size, distanceField);
+		if (cache.open(cachePath) && FontCache::read(cache, hash, size, distanceField, raster))
+			return true;
+	}
+
+	if (!openFace(library, data, size, face, err))
+		return false;
+
+	loaded = rasterize(face, distanceField, raster, err);
+	FT_Done_Face(face);
+
+	if (loaded && !cacheDir.empty() && !FontCache::write(cachePath, hash, size, distanceField, raster))
+		err << "(gui2d::Font::loadFont()) Could not write font cache: " << cachePath << std::endl;
+	return loaded;
+}
+
+/**
+ * Builds a font from its rasterized glyphs, composites them into the CPU copy of the atlas,
+ * and uploads them in one call
+ * @param id The id number assigned by the Manager
+ * @param manager A pointer to the owning manager
+ * @param atlas The glyph atlas to pack the glyphs into
+ * @param data The font file or buffer, which is opened if later glyphs are needed
+ * @param size The pixel size of the face
+ * @param raster The measured and rendered printable ASCII range
+ * @param err A stream to write later error messages to, which must outlive the font
+ * @param distanceField Whether the raster holds signed distance fields
+ * @return A pointer to the new Font instance
+ */
+gui2d::Font *gui2d::Font::createFont(int id, gui2d::Manager *manager, gui2d::GlyphAtlas *atlas, const gui2d::FontData& data, int size,
+										const gui2d::Font::FaceRaster& raster, std::ostream& err, bool distanceField) {
 	gui2d::Font *font;
-	unsigned char curChar;
-	int w, h, x;
-	GLubyte *blankImage;
-	FT_Pos maxAscent = 0, minDescent = 0;
+	std::vector<GlyphBitmap>::const_iterator glyph;
 	int sWidth = manager->getScreenWidth();
 	int sHeight = manager->getScreenHeight();
+	int spread = distanceField ? DISTANCE_SPREAD : 0;
+	int h, i;
 
 	// Create new Font instance and configure it
 	font = new Font();
 	font->_id = id;
 	font->_init = false;
 	font->_manager = manager;
+	font->_err = &err;
+	font->_data = data;
+	font->_face = NULL;
+	font->_faceFailed = false;
+	font->_atlas = atlas;
+	font->_atlasGeneration = atlas->getGeneration();
+	font->_generation = 0;
+	font->_maxWidth = 0;
+	font->_distanceField = distanceField;
+	font->_size = size;
+	for (i = 0; i < LAST_CHAR; ++i) {
+		font->_ascii[i] = 0;
+	}
 
-	// Open font face for reading
-	if (FT_New_Face(*ft, path.c_str(), 0, &font->_face)) {
-		err << "(gui2d::Font::loadFont()) Could not open font: " << path.c_str() << std::endl;
-		delete font;
-		return NULL;
+	// Normalize the kerning table to screen units
+	memset(font->_kern, 0, sizeof(font->_kern));
+	font->_kerning = false;
+	for (i = 0; i < static_cast<int>(raster.kern.size()); ++i) {
+		font->_kern[i / CHAR_COUNT][i % CHAR_COUNT] = NORMALIZE(GLshort, raster.kern[i], 10, sWidth);
+		if (font->_kern[i / CHAR_COUNT][i % CHAR_COUNT] != 0)
+			font->_kerning = true;
 	}
 
-	// Configure our font face
-	FT_Set_Pixel_Sizes(font->_face, 0, size);
-	font->_kerning = FT_HAS_KERNING(font->_face);
-	g = font->_face->glyph;
+	// Compute the height of the image from the ascent and descent, and leave room for the
+	// distance field to fall off above and below
+	h = raster.maxAscent - raster.minDescent + 1;
+	font->_maxAscent = raster.maxAscent + spread;
+	font->_glyphHeight = h + 2*spread;
+
+	// Make room in the atlas for the printable ASCII range, which is composited into its CPU
+	// copy and then uploaded in one call
+	atlas->reserve(raster.widths*(font->_glyphHeight + GlyphAtlas::PADDING), std::max(raster.maxWidth, font->_glyphHeight));
+	for (glyph = raster.glyphs.begin(); glyph != raster.glyphs.end(); ++glyph) {
+		font->storeGlyph(*glyph);
+	}
+	atlas->flush();
 
-	// Iterate over the characters we plan on displaying and measure their size
-	w = h = 0;
-	for (curChar = 32; curChar < 128; ++curChar) {
-		if (FT_Load_Char(font->_face, curChar, FT_LOAD_RENDER)) {
-			err << "(gui2d::Font::loadFont()) Could not load character: " << curChar << std::endl;
-			delete font;
-			return NULL;
+	font->_texHeight = NORMALIZE(GLshort, h, 16, sHeight);
+	font->_maxDescender = NORMALIZE(GLshort, abs(raster.minDescent), 16, sHeight);
+	font->_padding = NORMALIZE(GLshort, spread, 16, sHeight);
+	font->_height = static_cast<float>(2*h)/sHeight;
+	font->_init = true;
+	return font;
+}
+
+/**
+ * Factory constructor for fonts that draw the glyphs of a distance field font at another
+ * size. Nothing is rasterized; every metric is scaled from the source font, including its
+ * kerning table. This should only be called by the Manager in order to ensure consistent id
+ * assignments.
+ * @param id The id number assigned by the Manager
+ * @param source The distance field font to draw glyphs from, which must outlive this font
+ * @param size The pixel size to draw glyphs at
+ * @return A pointer to the new Font instance
+ */
+gui2d::Font *gui2d::Font::scaleFont(int id, gui2d::Font *source, int size) {
+	gui2d::Font *font;
+	float scale = static_cast<float>(size) / source->_size;
+	int left, right;
+
+	font = new Font();
+	font->_id = id;
+	font->_manager = source->_manager;
+	font->_atlas = source->_atlas;
+	font->_source = source;
+	font->_face = NULL;
+	font->_faceFailed = true;
+	font->_scale = scale;
+	font->_distanceField = true;
+	font->_generation = 0;
+	font->_maxWidth = 0;
+	for (left = 0; left < LAST_CHAR; ++left) {
+		font->_ascii[left] = 0;
+	}
+
+	font->_kerning = source->_kerning;
+	for (left = 0; left < CHAR_COUNT; ++left) {
+		for (right = 0; right < CHAR_COUNT; ++right) {
+			font->_kern[left][right] = static_cast<GLshort>(source->_kern[left][right]*scale);
 		}
+	}
+
+	font->_size = size;
+	font->_texHeight = static_cast<GLshort>(source->_texHeight*scale);
+	font->_maxDescender = static_cast<GLshort>(source->_maxDescender*scale);
+	font->_padding = static_cast<GLshort>(source->_padding*scale);
+	font->_height = source->_height*scale;
+	font->_init = true;
+	return font;
+}
+
+/**
+ * Look up the drawing information for a codepoint, rasterizing it into the atlas if it is
+ * not already cached, and mark it as the most recently used glyph in the atlas. Scaled
+ * fonts look the glyph up in their source font, and return a scaled copy that is only valid
+ * until the next lookup.
+ * @param codepoint The unicode codepoint whose info we need to look up
+ * @return pointer to a character info struct for the glyph
+ */
+const gui2d::Font::char_info *gui2d::Font::getCharInfo(uint32_t codepoint) {
+	CachedGlyph *glyph;
+	GlyphMap::iterator iter;
+	const char_info *ci;
+
+	if (_source) {
+		ci = _source->getCharInfo(codepoint);
+		_scaled = *ci;
 
-		w += g->bitmap.width;
-		maxAscent = std::max(maxAscent, g->metrics.horiBearingY/64);
-		minDescent = std::min(minDescent, g->metrics.horiBearingY/64 - g->bitmap.rows);
+		// Offsets may be negative, so they are scaled as signed values
+		_scaled.ax = static_cast<GLushort>(ci->ax*_scale);
+		_scaled.sbw = static_cast<GLushort>(ci->sbw*_scale);
+		_scaled.bl = static_cast<GLushort>(static_cast<GLshort>(ci->bl)*_scale);
+		return &_scaled;
 	}
 
-	// Compute the height of the image from the ascent and descent
-	h = maxAscent - minDescent + 1;
+	if (_atlasGeneration != _atlas->getGeneration())
+		remapGlyphs();
 
-	// Now create the texture that we need for our atlas
-	glActiveTexture(GL_TEXTURE0);
-	glGenTextures(1, &font->_texture);
-	glBindTexture(GL_TEXTURE_2D, font->_texture);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (codepoint < LAST_CHAR && _ascii[codepoint]) {
+		glyph = _ascii[codepoint];
+	}
+	else {
+		iter = _glyphs.find(codepoint);
+		if (iter != _glyphs.end())
+			glyph = &iter->second;
+		else
+			glyph = cacheGlyph(codepoint);
+	}
 
-	// Configure texture wrapping and filtering
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	if (glyph->region.shelf >= 0)
+		_atlas->touch(glyph->region);
+	return &glyph->info;
+}
 
-	// We store in a single channel. This gets interpreted as an alpha value in the shader,
-	// but the only single channel option is GL_RED
-	blankImage = new GLubyte[w*h];
-	memset(blankImage, 0, w*h*sizeof(GLubyte));
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, blankImage);
-	delete[] blankImage;
+/**
+ * Drops a glyph from the cache because the atlas is reclaiming its space. This is only
+ * called by the atlas, which frees the region itself.
+ * @param codepoint The codepoint of the evicted glyph
+ * @param region Filled in with the atlas region that the glyph held
+ */
+void gui2d::Font::evict(uint32_t codepoint, gui2d::GlyphAtlas::Region& region) {
+	GlyphMap::iterator iter = _glyphs.find(codepoint);
 
-	// Iterate over characters again and copy bitmaps to the texture
-	x = 0;
-	font->_maxWidth = 0;
-	for (curChar = 32; curChar < 128; ++curChar) {
-		if (FT_Load_Char(font->_face, curChar, FT_LOAD_RENDER))
-			continue;
-		
+	region = iter->second.region;
+	if (codepoint < static_cast<uint32_t>(LAST_CHAR))
+		_ascii[codepoint] = 0;
+	_glyphs.erase(iter);
+	_generation += 1;
+}
+
+/**
+ * Computes the normalized texture coordinates of a glyph from its atlas region
+ * @param glyph The glyph to update
+ */
+void gui2d::Font::mapGlyph(gui2d::Font::CachedGlyph& glyph) {
+	const GlyphAtlas::Region& r = glyph.region;
+	int size = _atlas->getSize();
+
+	if (r.shelf < 0)
+		return;
+
+	glyph.info.tx = NORMALIZE(GLushort, r.x, 16, size);
+	glyph.info.txEnd = NORMALIZE(GLushort, r.x + r.width, 16, size);
+	glyph.info.ty = NORMALIZE(GLushort, r.y, 16, size);
+	glyph.info.tyEnd = NORMALIZE(GLushort, r.y + r.height, 16, size);
+}
+
+/**
+ * Recomputes the texture coordinates of every cached glyph after the atlas has grown
+ */
+void gui2d::Font::remapGlyphs(void) {
+	GlyphMap::iterator iter;
+
+	for (iter = _glyphs.begin(); iter != _glyphs.end(); ++iter) {
+		mapGlyph(iter->second);
+	}
+	_atlasGeneration = _atlas->getGeneration();
+}
+
+/**
+ * Rasterizes a glyph with FreeType on demand and copies its bitmap into the atlas
+ * @param codepoint The unicode codepoint to rasterize
+ * @return The new cache entry, which is already in the atlas' recently used list
+ */
+gui2d::Font::CachedGlyph *gui2d::Font::cacheGlyph(uint32_t codepoint) {
+	GlyphBitmap bitmap;
+
+	// The face is only needed once a glyph is missing from the preloaded range
+	if (!_face && !_faceFailed)
+		_faceFailed = !openFace(*_manager->getFreeTypeLibrary(), _data, _size, _face, *_err);
+
+	renderGlyph(_face, codepoint, _distanceField, bitmap);
+	return storeGlyph(bitmap);
+}
+
+/**
+ * Adds a rendered glyph to the cache, copying its bitmap into the atlas
+ * @param bitmap The rendered glyph, which is cached without an atlas region if it is blank
+ * @return The new cache entry, which is already in the atlas' recently used list
+ */
+gui2d::Font::CachedGlyph *gui2d::Font::storeGlyph(const gui2d::Font::GlyphBitmap& bitmap) {
+	CachedGlyph glyph;
+	CachedGlyph *result;
+	int sWidth = _manager->getScreenWidth();
+	int width = bitmap.width;
+	bool missing = false;
+
+	memset(&glyph.info, 0, sizeof(glyph.info));
+	glyph.region.shelf = -1;
+
+	if (width > 0 && _atlas->allocate(width, _glyphHeight, this, bitmap.codepoint, glyph.region)) {
 		// Store the image so that all the glyphs share the same baseline position
-		glTexSubImage2D(GL_TEXTURE_2D, 0, x, static_cast<GLint>(maxAscent - g->bitmap_top), g->bitmap.width, g->bitmap.rows, GL_RED, GL_UNSIGNED_BYTE, g->bitmap.buffer);
+		_atlas->write(glyph.region, &bitmap.pixels[0], bitmap.width, width, bitmap.rows, static_cast<int>(_maxAscent - bitmap.top));
+		if (_atlasGeneration != _atlas->getGeneration())
+			remapGlyphs();
+		mapGlyph(glyph);
+	}
+	else {
+		// Glyphs that only lack room right now are not cached, so that they are tried again
+		missing = width > 0 && _atlas->fits(width, _glyphHeight);
+		width = 0;
+	}
 
-		// Save the character information for later use, note that all of these are normalized integers
-		// so 0 -> 0.0f, and 65535 -> 1.0f, the other end of the texture in that direction,
-		// To accomplish this in an N-bit integer type we multiply the desired value by (2^N/norm), where
-		// norm is the maximum value for the normalized data type.
-		// Advance is in 1/64 of pixel, so we don't normalize it to the width of the texture;
-		// instead we normalize it to the screen dimensions
-		font->_info[curChar].ax = NORMALIZE(GLushort, g->advance.x, 10, sWidth);
-		font->_info[curChar].sbw = NORMALIZE(GLushort, g->bitmap.width, 16, sWidth);
-		font->_info[curChar].bl = NORMALIZE(GLushort, g->bitmap_left, 16, sWidth);
-		font->_info[curChar].tx = NORMALIZE(GLushort, x, 16, w);
-		font->_info[curChar].txEnd = NORMALIZE(GLushort, x+g->bitmap.width, 16, w);
+	// Save the character information for later use, note that all of these are normalized integers
+	// so 0 -> 0.0f, and 65535 -> 1.0f, the other end of the texture in that direction,
+	// To accomplish this in an N-bit integer type we multiply the desired value by (2^N/norm), where
+	// norm is the maximum value for the normalized data type.
+	// Advance is in 1/64 of pixel, so we don't normalize it to the width of the texture;
+	// instead we normalize it to the screen dimensions
+	glyph.info.ax = NORMALIZE(GLushort, bitmap.advance, 10, sWidth);
+	glyph.info.sbw = NORMALIZE(GLushort, width, 16, sWidth);
+	glyph.info.bl = NORMALIZE(GLushort, bitmap.left, 16, sWidth);
 
-		// Increment the x offset within the texture by the width of the bitmap
-		x += g->bitmap.width;
+	// Update the maximum glyph width
+	_maxWidth = std::max(_maxWidth, glyph.info.ax);
 
-		// Update the maximum glyph width
-		font->_maxWidth = std::max(font->_maxWidth, font->_info[curChar].ax);
+	if (missing) {
+		_missing = glyph;
+		return &_missing;
 	}
 
-	font->_texHeight = NORMALIZE(GLshort, h, 16, sHeight);
-	font->_maxDescender = NORMALIZE(GLshort, abs(minDescent), 16, sHeight);
-	font->_height = static_cast<float>(2*h)/sHeight;
-	font->_init = true;
-	return font;
+	result = &(_glyphs[bitmap.codepoint] = glyph);
+	if (bitmap.codepoint < static_cast<uint32_t>(LAST_CHAR))
+		_ascii[bitmap.codepoint] = result;
+	return result;
+}
+
+/**
+ * Decodes one codepoint from a UTF-8 string and advances past it. Malformed sequences
+ * decode to REPLACEMENT_CHAR one byte at a time.
+ * @param c Pointer to the first byte of the sequence, which is moved to the next one
+ * @return The decoded codepoint
+ */
+uint32_t gui2d::Font::decodeUTF8(const char *&c) {
+	const unsigned char *s = reinterpret_cast<const unsigned char *>(c);
+	uint32_t codepoint;
+	int extra, i;
+
+	if (s[0] < 0x80) {
+		c += 1;
+		return s[0];
+	}
+	else if ((s[0] & 0xE0) == 0xC0) {
+		codepoint = s[0] & 0x1F;
+		extra = 1;
+	}
+	else if ((s[0] & 0xF0) == 0xE0) {
+		codepoint = s[0] & 0x0F;
+		extra = 2;
+	}
+	else if ((s[0] & 0xF8) == 0xF0) {
+		codepoint = s[0] & 0x07;
+		extra = 3;
+	}
+	else {
+		c += 1;
+		return REPLACEMENT_CHAR;
+	}
+
+	// Continuation bytes must all be present, which also stops at the terminator
+	for (i = 1; i <= extra; ++i) {
+		if ((s[i] & 0xC0) != 0x80) {
+			c += 1;
+			return REPLACEMENT_CHAR;
+		}
+		codepoint = (codepoint << 6) | (s[i] & 0x3F);
+	}
+
+	c += extra + 1;
+	return codepoint;
 }
 
 /**
@@ -145,6 +610,8 @@ gui2d::Font *gui2d::Font::loadFont(int id, gui2d::Manager *manager, const std::s
  * @return Normalized length of the string
  */
 GLuint gui2d::Font::getMaxStringWidth(int count) {
+	if (_source)
+		return static_cast<GLuint>(_source->getMaxStringWidth(count)*_scale);
 	return count * _maxWidth;
 }
 
@@ -156,25 +623,26 @@ GLuint gui2d::Font::getMaxStringWidth(int count) {
  * @return Width of the string as displayed by this font
  */
 GLuint gui2d::Font::getStringWidth(const std::string& text) {
-	const char *c;
-	const char *p = 0;
+	const char *c = text.c_str();
+	uint32_t codepoint, prev = 0;
 	const gui2d::Font::char_info *ci;
 	GLuint tempX = 0;
 
-	for (c = text.c_str(); *c != 0; c++) {
-		ci = getCharInfo(*c);
+	while (*c != 0) {
+		codepoint = decodeUTF8(c);
+		ci = getCharInfo(codepoint);
 		tempX += ci->ax;
 
 		// Account for kerning
-		if (p)
-			tempX += getKerning(*p, *c);
+		if (prev && _kerning)
+			tempX += getKerning(prev, codepoint);
 
 		// Save previous character
-		p = c;
+		prev = codepoint;
 		
 		// Disable kerning for next iteration on zero width glyph
 		if (ci->sbw == 0)
-			p = 0;
+			prev = 0;
 	}
 
 	return tempX;
@@ -189,23 +657,3 @@ GLuint gui2d::Font::getStringWidth(const std::string& text) {
 float gui2d::Font::getStringWidthf(const std::string& text) {
 	return getStringWidth(text) / static_cast<float>(1 << 15);
 }
-
-/**
- * Retrieve kerning information for a pair of characters, and since we only use horizontal layouts,
- * return the x distance after normalizing to screen units.
- * @param left The left character in the kerning pair
- * @param right The right character in the kerning pair
- * @return The adjustment due to kerning for this pair of characters; it may be positive or negative
- */
-GLshort gui2d::Font::getKerning(FT_UInt left, FT_UInt right) {
-	FT_Vector kern;
-	int sWidth = _manager->getScreenWidth();
-	
-	if (_kerning) {
-		FT_Get_Kerning(_face, left, right, FT_KERNING_DEFAULT, &kern);
-
-		return NORMALIZE(GLshort, kern.x, 10, sWidth);
-	}
-	
-	return 0;
-}
@@ -0,0 +1,216 @@
+/**
+ * @file 2dgui/FontCache.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <stdint.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/FontCache.h"
+#include "2dgui/Font.h"
+#include "2dgui/MappedFile.h"
+
+/**
+ * Hashes the contents of a font file with 64-bit FNV-1a
+ * @param data The contents of the font file
+ * @param size Size of the contents, in bytes
+ * @return The hash
+ */
+uint64_t gui2d::FontCache::hash(const unsigned char *data, size_t size) {
+	uint64_t h = 14695981039346656037ULL;
+	size_t i;
+
+	for (i = 0; i < size; ++i) {
+		h = (h ^ data[i]) * 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * Hashes the contents of a mapped font file with 64-bit FNV-1a
+ * @param file The mapped font file
+ * @return The hash
+ */
+uint64_t gui2d::FontCache::hash(const gui2d::MappedFile& file) {
+	return hash(file.getData(), file.getSize());
+}
+
+/**
+ * Builds the file name that a font is cached under
+ * @param hash Hash of the font file
+ * @param size Pixel size the glyphs are rasterized at
+ * @param distanceField Whether the glyphs are distance fields
+ * @return The file name, without a directory
+ */
+std::string gui2d::FontCache::getName(uint64_t hash, int size, bool distanceField) {
+	char name[64];
+
+	snprintf(name, sizeof(name), "%016llx-%d%s.g2df", static_cast<unsigned long long>(hash), size, distanceField ? "-sdf" : "");
+	return std::string(name);
+}
+
+/**
+ * Reads a cached raster, checking that it matches the font it is expected to hold
+ * @param file The mapped cache file
+ * @param hash Hash of the font file
+ * @param size Pixel size the glyphs must have been rasterized at
+ * @param distanceField Whether the glyphs must be distance fields
+ * @param raster Filled in with the cached glyphs
+ * @return True if the file was valid and matched
+ */
+bool gui2d::FontCache::read(const gui2d::MappedFile& file, uint64_t hash, int size, bool distanceField, gui2d::Font::FaceRaster& raster) {
+	const unsigned char *data = file.getData();
+	const unsigned char *pixels;
+	Header header;
+	GlyphRecord record;
+	int32_t kern;
+	size_t offset, i;
+
+	if (file.getSize() < sizeof(Header))
+		return false;
+
+	memcpy(&header, data, sizeof(Header));
+	if (memcmp(header.magic, "G2DF", 4) != 0 || header.version != VERSION || header.hash != hash ||
+			header.size != size || (header.distanceField != 0) != distanceField ||
+			header.spread != (distanceField ? Font::DISTANCE_SPREAD : 0) ||
+			header.glyphCount != Font::CHAR_COUNT || (header.kernCount != 0 && header.kernCount != Font::CHAR_COUNT*Font::CHAR_COUNT))
+		return false;
+
+	// Every part of the file must be present before anything is copied out of it
+	offset = sizeof(Header) + header.glyphCount*sizeof(GlyphRecord) + header.kernCount*sizeof(int32_t);
+	if (file.getSize() < offset || file.getSize() - offset < header.pixelBytes)
+		return false;
+	pixels = data + offset;
+
+	raster.maxAscent = header.maxAscent;
+	raster.minDescent = header.minDescent;
+	raster.maxWidth = header.maxWidth;
+	raster.widths = header.widths;
+
+	raster.glyphs.resize(header.glyphCount);
+	for (i = 0; i < raster.glyphs.size(); ++i) {
+		Font::GlyphBitmap& glyph = raster.glyphs[i];
+
+		memcpy(&record, data + sizeof(Header) + i*sizeof(GlyphRecord), sizeof(GlyphRecord));
+		if (record.width < 0 || record.rows < 0 || record.offset > header.pixelBytes ||
+				header.pixelBytes - record.offset < static_cast<uint64_t>(record.width)*record.rows)
+			return false;
+
+		glyph.codepoint = record.codepoint;
+		glyph.advance = record.advance;
+		glyph.left = record.left;
+		glyph.top = record.top;
+		glyph.width = record.width;
+		glyph.rows = record.rows;
+		glyph.ascent = record.ascent;
+		glyph.descent = record.descent;
+		glyph.pixels.assign(pixels + record.offset, pixels + record.offset + record.width*record.rows);
+	}
+
+	raster.kern.resize(header.kernCount);
+	for (i = 0; i < raster.kern.size(); ++i) {
+		memcpy(&kern, data + sizeof(Header) + header.glyphCount*sizeof(GlyphRecord) + i*sizeof(int32_t), sizeof(int32_t));
+		raster.kern[i] = kern;
+	}
+
+	return true;
+}
+
+/**
+ * Writes a raster to the cache. The file is written under a temporary name first, so that
+ * readers never see a partial file. The temporary name is unique to the writing thread and
+ * call, since several workers may bake the same entry at once.
+ * @param path Path of the cache file to write
+ * @param hash Hash of the font file
+ * @param size Pixel size the glyphs were rasterized at
+ * @param distanceField Whether the glyphs are distance fields
+ * @param raster The glyphs to cache
+ * @return True if the file was written
+ */
+bool gui2d::FontCache::write(const std::string& path, uint64_t hash, int size, bool distanceField, const gui2d::Font::FaceRaster& raster) {
+	static std::atomic<unsigned int> writes(0);
+	std::ostringstream temp;
+	std::ofstream out;
+	std::vector<Font::GlyphBitmap>::const_iterator glyph;
+	std::vector<FT_Pos>::const_iterator kernIter;
+	Header header;
+	GlyphRecord record;
+	int32_t kern;
+	uint64_t offset = 0;
+
+	// Clear the padding before widths, so that identical bakes write identical files
+	memset(&header, 0, sizeof(Header));
+	memcpy(header.magic, "G2DF", 4);
+	header.version = VERSION;
+	header.hash = hash;
+	header.size = size;
+	header.distanceField = distanceField ? 1 : 0;
+	header.spread = distanceField ? Font::DISTANCE_SPREAD : 0;
+	header.glyphCount = raster.glyphs.size();
+	header.kernCount = raster.kern.size();
+	header.maxAscent = raster.maxAscent;
+	header.minDescent = raster.minDescent;
+	header.maxWidth = raster.maxWidth;
+	header.widths = raster.widths;
+	header.pixelBytes = 0;
+	for (glyph = raster.glyphs.begin(); glyph != raster.glyphs.end(); ++glyph) {
+		header.pixelBytes += glyph->pixels.size();
+	}
+
+	temp << path << "." << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << "." << writes++ << ".tmp";
+	out.open(temp.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+
+	for (glyph = raster.glyphs.begin(); glyph != raster.glyphs.end(); ++glyph) {
+		memset(&record, 0, sizeof(GlyphRecord));
+		record.codepoint = glyph->codepoint;
+		record.advance = glyph->advance;
+		record.left = glyph->left;
+		record.top = glyph->top;
+		record.width = glyph->width;
+		record.rows = glyph->rows;
+		record.ascent = glyph->ascent;
+		record.descent = glyph->descent;
+		record.offset = offset;
+		offset += glyph->pixels.size();
+		out.write(reinterpret_cast<const char *>(&record), sizeof(GlyphRecord));
+	}
+
+	for (kernIter = raster.kern.begin(); kernIter != raster.kern.end(); ++kernIter) {
+		kern = static_cast<int32_t>(*kernIter);
+		out.write(reinterpret_cast<const char *>(&kern), sizeof(int32_t));
+	}
+
+	for (glyph = raster.glyphs.begin(); glyph != raster.glyphs.end(); ++glyph) {
+		if (!glyph->pixels.empty())
+			out.write(reinterpret_cast<const char *>(&glyph->pixels[0]), glyph->pixels.size());
+	}
+
+	out.close();
+	if (!out) {
+		std::remove(temp.str().c_str());
+		return false;
+	}
+
+	// Renaming over an existing file fails on some platforms, and the old one is stale anyway
+	std::remove(path.c_str());
+	if (std::rename(temp.str().c_str(), path.c_str()) != 0) {
+		std::remove(temp.str().c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file 2dgui/FontLoader.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <sstream>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/FontLoader.h"
+#include "2dgui/Font.h"
+
+/**
+ * Starts the worker threads, which wait for jobs to be submitted
+ * @param workers The number of threads to start, at least one
+ */
+gui2d::FontLoader::FontLoader(int workers) : _stopping(false) {
+	int i;
+
+	for (i = 0; i < std::max(workers, 1); ++i) {
+		_workers.push_back(std::thread(&gui2d::FontLoader::work, this));
+	}
+}
+
+/**
+ * Stops the workers once they finish their current jobs, and discards every job that has
+ * not been taken
+ */
+gui2d::FontLoader::~FontLoader(void) {
+	std::vector<std::thread>::iterator worker;
+	JobMap::iterator iter;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_queued.notify_all();
+
+	for (worker = _workers.begin(); worker != _workers.end(); ++worker) {
+		worker->join();
+	}
+
+	for (iter = _jobs.begin(); iter != _jobs.end(); ++iter) {
+		delete iter->second;
+	}
+}
+
+/**
+ * Body of each worker thread: rasterizes queued jobs with a library of its own until the
+ * pool is stopped
+ */
+void gui2d::FontLoader::work(void) {
+	FT_Library library;
+	std::ostringstream err;
+	bool initialized;
+	bool loaded;
+	Job *job;
+
+	initialized = !FT_Init_FreeType(&library);
+	if (initialized)
+		Font::configureLibrary(library);
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (_queue.empty() && !_stopping) {
+				_queued.wait(lock);
+			}
+			if (_stopping)
+				break;
+
+			job = _queue.front();
+			_queue.pop_front();
+		}
+
+		// The job is only touched by this thread until it is marked as done
+		err.str("");
+		loaded = false;
+		if (!initialized) {
+			err << "(gui2d::FontLoader::work()) Unable to initialize FreeType library!" << std::endl;
+		}
+		else {
+			loaded = Font::loadRaster(library, job->data, job->distanceField ? Font::DISTANCE_SIZE : job->size, job->distanceField,
+										job->cacheDir, job->raster, err);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			job->done = true;
+			job->failed = !loaded;
+			job->error = err.str();
+		}
+		_finished.notify_all();
+	}
+
+	if (initialized)
+		FT_Done_FreeType(library);
+}
+
+/**
+ * Queues a font to be rasterized by the next free worker
+ * @param handle Handle that identifies the job, which must not be in use
+ * @param data The font file, or a buffer holding one, which must stay valid until the job is taken
+ * @param size Pixel size of the font
+ * @param distanceField Rasterize the face's distance field glyphs instead, which serve every size
+ * @param cacheDir Directory of FontCache files to read the glyphs from or write them to, or empty
+ */
+void gui2d::FontLoader::submit(int handle, const gui2d::FontData& data, int size, bool distanceField, const std::string& cacheDir) {
+	Job *job = new Job();
+
+	job->handle = handle;
+	job->data = data;
+	job->size = size;
+	job->distanceField = distanceField;
+	job->cacheDir = cacheDir;
+	job->done = false;
+	job->failed = false;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs[handle] = job;
+		_queue.push_back(job);
+	}
+	_queued.notify_one();
+}
+
+/**
+ * Check whether a job is still waiting for or being rasterized by a worker
+ * @param handle Handle of the job
+ * @return True if the job exists and has not finished
+ */
+bool gui2d::FontLoader::isPending(int handle) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	JobMap::iterator iter = _jobs.find(handle);
+
+	return iter != _jobs.end() && !iter->second->done;
+}
+
+/**
+ * Waits for a job to finish and takes ownership of it
+ * @param handle Handle of the job
+ * @return The finished job, which the caller must delete, or null if there is no such job
+ */
+gui2d::FontLoader::Job *gui2d::FontLoader::take(int handle) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	JobMap::iterator iter = _jobs.find(handle);
+	Job *job;
+
+	if (iter == _jobs.end())
+		return NULL;
+
+	job = iter->second;
+	while (!job->done) {
+		_finished.wait(lock);
+	}
+
+	_jobs.erase(handle);
+	return job;
+}
+
+/**
+ * Lists the jobs that have finished, which take() will return without waiting
+ * @param handles The handles of finished jobs are appended to this list
+ */
+void gui2d::FontLoader::getFinished(std::vector<int>& handles) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	JobMap::iterator iter;
+
+	for (iter = _jobs.begin(); iter != _jobs.end(); ++iter) {
+		if (iter->second->done)
+			handles.push_back(iter->first);
+	}
+}
@@ -0,0 +1,464 @@
+/**
+ * @file 2dgui/GlyphAtlas.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <algorithm>
+#include <cstring>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/GlyphAtlas.h"
+#include "2dgui/Font.h"
+
+/**
+ * Creates the texture at the smallest size; fonts reserve the room they need before adding
+ * glyphs. Its storage is specified by the first flush().
+ * @param filter Texture filter to sample with, which should be GL_LINEAR for distance fields
+ */
+gui2d::GlyphAtlas::GlyphAtlas(GLint filter) : _texture(0), _size(MIN_SIZE), _pixels(0), _shelfTop(0),
+		_usedArea(0), _generation(0), _frame(0), _resized(true) {
+	GLint maxTextureSize;
+
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	_maxSize = std::min(static_cast<int>(maxTextureSize), static_cast<int>(MAX_SIZE));
+
+	_pixels = new GLubyte[_size*_size];
+	memset(_pixels, 0, _size*_size*sizeof(GLubyte));
+
+	glActiveTexture(GL_TEXTURE0);
+	glGenTextures(1, &_texture);
+	glBindTexture(GL_TEXTURE_2D, _texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+}
+
+/**
+ * Releases the texture and the CPU copy of the atlas
+ */
+gui2d::GlyphAtlas::~GlyphAtlas(void) {
+	glDeleteTextures(1, &_texture);
+	delete[] _pixels;
+}
+
+/**
+ * Finds the first free span on a shelf that is wide enough for a region
+ * @param shelf The shelf to search
+ * @param width Width of the region, including padding
+ * @return Iterator to the span, or the end of the shelf's free spans if none fits
+ */
+gui2d::GlyphAtlas::SpanMap::iterator gui2d::GlyphAtlas::findSpan(Shelf& shelf, int width) {
+	SpanMap::iterator iter;
+
+	for (iter = shelf.free.begin(); iter != shelf.free.end(); ++iter) {
+		if (iter->second >= width)
+			break;
+	}
+	return iter;
+}
+
+/**
+ * Grows the atlas ahead of time so that it can hold an additional area with room to spare
+ * @param area Expected area of the regions that will be allocated soon, including padding
+ * @param minSize Largest width or height of those regions
+ */
+void gui2d::GlyphAtlas::reserve(size_t area, int minSize) {
+	size_t needed = (_usedArea + area)*HEADROOM;
+
+	while (static_cast<size_t>(_size)*_size < needed || _size < minSize + PADDING) {
+		if (!grow())
+			break;
+	}
+}
+
+/**
+ * Finds room for a region in the free space of the atlas. If there is none, the request is
+ * remembered so that update() can grow the atlas or evict regions before the next frame.
+ * @param width Width of the region, in pixels
+ * @param height Height of the region, in pixels
+ * @param font Font that will own the region, which is told if the region is evicted
+ * @param codepoint Codepoint of the glyph that the region will hold
+ * @param region Filled in with the location of the region
+ * @return True if the region was allocated, false if it does not fit at the moment, or can
+ * never fit if fits() is also false
+ */
+bool gui2d::GlyphAtlas::allocate(int width, int height, gui2d::Font *font, uint32_t codepoint, gui2d::GlyphAtlas::Region& region) {
+	Owner owner;
+	Request request;
+
+	// Evicting everything would not help a region that is larger than the atlas can be
+	if (!fits(width, height))
+		return false;
+
+	if (!place(width, height, region)) {
+		request.font = font;
+		request.width = width;
+		request.height = height;
+		_requests.push_back(request);
+		return false;
+	}
+
+	owner.font = font;
+	owner.codepoint = codepoint;
+	owner.shelf = region.shelf;
+	owner.frame = _frame;
+	region.lru = _lru.insert(_lru.begin(), owner);
+	return true;
+}
+
+/**
+ * Finds space for a region, preferring the shortest shelf that it fits on, and opening a
+ * new shelf below the others if no existing one has room
+ * @param width Width of the region, in pixels
+ * @param height Height of the region, in pixels
+ * @param region Filled in with the location of the region if there was room
+ * @return True if the region was placed, false if the atlas must grow or release space first
+ */
+bool gui2d::GlyphAtlas::place(int width, int height, gui2d::GlyphAtlas::Region& region) {
+	int paddedWidth = width + PADDING;
+	int paddedHeight = height + PADDING;
+	int best = -1;
+	int i;
+	SpanMap::iterator span, bestSpan;
+	Shelf shelf;
+
+	// Shelves are only shared with regions that are not much shorter, to limit wasted rows,
+	// unless nothing else is on them
+	for (i = 0; i < static_cast<int>(_shelves.size()); ++i) {
+		if (_shelves[i].height < paddedHeight)
+			continue;
+		if (_shelves[i].height > 2*paddedHeight && !isEmpty(_shelves[i]))
+			continue;
+		if (best >= 0 && _shelves[i].height >= _shelves[best].height)
+			continue;
+
+		span = findSpan(_shelves[i], paddedWidth);
+		if (span != _shelves[i].free.end()) {
+			best = i;
+			bestSpan = span;
+		}
+	}
+
+	if (best < 0) {
+		if (paddedWidth > _size || _shelfTop + paddedHeight > _size)
+			return false;
+
+		shelf.y = _shelfTop;
+		shelf.height = paddedHeight;
+		shelf.free[0] = _size;
+		shelf.dirtyMin = -1;
+		shelf.dirtyMax = -1;
+		_shelves.push_back(shelf);
+		_shelfTop += paddedHeight;
+
+		best = _shelves.size() - 1;
+		bestSpan = _shelves[best].free.begin();
+	}
+
+	Shelf& s = _shelves[best];
+	region.shelf = best;
+	region.x = bestSpan->first;
+	region.y = s.y;
+	region.width = width;
+	region.height = height;
+
+	if (bestSpan->second > paddedWidth)
+		s.free[bestSpan->first + paddedWidth] = bestSpan->second - paddedWidth;
+	s.free.erase(bestSpan);
+
+	_usedArea += paddedWidth*s.height;
+	return true;
+}
+
+/**
+ * Checks whether a region could be placed right now, without allocating it
+ * @param width Width of the region, in pixels
+ * @param height Height of the region, in pixels
+ * @return True if place() would succeed
+ */
+bool gui2d::GlyphAtlas::hasRoom(int width, int height) {
+	Region region;
+
+	if (!place(width, height, region))
+		return false;
+
+	releaseSpan(region);
+	return true;
+}
+
+/**
+ * Frees a region that its owner no longer needs
+ * @param region The region to release, which must not be used again
+ */
+void gui2d::GlyphAtlas::release(const gui2d::GlyphAtlas::Region& region) {
+	_lru.erase(region.lru);
+	releaseSpan(region);
+}
+
+/**
+ * Forgets the failed allocations of a font that is being destroyed
+ * @param font The font whose requests are dropped
+ */
+void gui2d::GlyphAtlas::cancel(gui2d::Font *font) {
+	size_t i = 0;
+
+	while (i < _requests.size()) {
+		if (_requests[i].font == font) {
+			_requests[i] = _requests.back();
+			_requests.pop_back();
+		}
+		else {
+			i += 1;
+		}
+	}
+}
+
+/**
+ * Per-frame maintenance, which must run before any string copies its texture coordinates.
+ * Makes room for the allocations that failed since the last call, first by growing the atlas
+ * and then by evicting the least recently used regions, and tells the fonts that asked to
+ * retry. Whatever still does not fit after MAX_EVICTIONS evictions waits for the next frame.
+ */
+void gui2d::GlyphAtlas::update(void) {
+	std::vector<Request>::iterator iter;
+	int evictions = 0;
+
+	for (iter = _requests.begin(); iter != _requests.end(); ++iter) {
+		while (!hasRoom(iter->width, iter->height)) {
+			if (!grow())
+				break;
+		}
+
+		// Regions on shelves that fit the request are reclaimed first, then those that can
+		// only help once their shelf is empty
+		if (!evictFor(iter->width, iter->height, evictions)) {
+			if (evictions >= MAX_EVICTIONS)
+				break;
+		}
+
+		iter->font->retryGlyphs();
+	}
+
+	// Fonts whose requests were cut off by the limit still retry, and ask again if they must
+	for (; iter != _requests.end(); ++iter) {
+		iter->font->retryGlyphs();
+	}
+
+	_requests.clear();
+	_frame += 1;
+}
+
+/**
+ * Checks whether evicting a region from a shelf could make room for a region of some height
+ * @param shelf The shelf holding the region
+ * @param height Height of the requested region, including padding
+ * @param preferred Only accept shelves that place() would share with the request as they are
+ * @return True if the shelf is worth evicting from
+ */
+bool gui2d::GlyphAtlas::canReclaim(int shelf, int height, bool preferred) const {
+	const Shelf& s = _shelves[shelf];
+
+	if (preferred)
+		return s.height >= height && s.height <= 2*height;
+
+	// A taller shelf can take the region once it is empty, and the last shelf gives its rows
+	// back to new shelves of any height
+	return s.height > 2*height || (s.height < height && shelf == static_cast<int>(_shelves.size()) - 1);
+}
+
+/**
+ * Evicts the least recently used regions that could make room for a region, until it fits,
+ * skipping those used during the frame that asked for it
+ * @param width Width of the region, in pixels
+ * @param height Height of the region, in pixels
+ * @param evictions The number of regions evicted so far this frame, which is incremented
+ * @return True if the region now fits, false if no candidate is left or the limit was reached
+ */
+bool gui2d::GlyphAtlas::evictFor(int width, int height, int& evictions) {
+	OwnerLRU::iterator iter;
+	Region evicted;
+	int pass;
+
+	if (hasRoom(width, height))
+		return true;
+
+	for (pass = 0; pass < 2; ++pass) {
+		iter = _lru.end();
+		while (iter != _lru.begin() && evictions < MAX_EVICTIONS) {
+			--iter;
+			if (iter->frame == _frame || !canReclaim(iter->shelf, height + PADDING, pass == 0))
+				continue;
+
+			iter->font->evict(iter->codepoint, evicted);
+			releaseSpan(evicted);
+			iter = _lru.erase(iter);
+			evictions += 1;
+
+			if (hasRoom(width, height))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Returns a region's span to its shelf, merging it with its free neighbors. Empty shelves
+ * at the bottom are removed so that their rows can be used by regions of any height.
+ * @param region The region whose space is freed
+ */
+void gui2d::GlyphAtlas::releaseSpan(const gui2d::GlyphAtlas::Region& region) {
+	Shelf& s = _shelves[region.shelf];
+	int x = region.x;
+	int width = region.width + PADDING;
+	SpanMap::iterator next, prev;
+
+	_usedArea -= width*s.height;
+
+	// Merge with the following span
+	next = s.free.find(x + width);
+	if (next != s.free.end()) {
+		width += next->second;
+		s.free.erase(next);
+	}
+
+	// Merge with the preceding span
+	next = s.free.lower_bound(x);
+	if (next != s.free.begin()) {
+		prev = next;
+		--prev;
+		if (prev->first + prev->second == x) {
+			x = prev->first;
+			width += prev->second;
+			s.free.erase(prev);
+		}
+	}
+	s.free[x] = width;
+
+	while (!_shelves.empty() && isEmpty(_shelves.back())) {
+		_shelfTop = _shelves.back().y;
+		_shelves.pop_back();
+	}
+}
+
+/**
+ * Doubles the size of the atlas, keeping every region where it is and widening each shelf.
+ * This changes every normalized texture coordinate, so it must not be called mid-frame.
+ * @return True if the atlas grew, false if it is already as large as allowed
+ */
+bool gui2d::GlyphAtlas::grow(void) {
+	int newSize = _size*2;
+	GLubyte *pixels;
+	SpanMap::iterator last;
+	std::vector<Shelf>::iterator iter;
+	int row;
+
+	if (newSize > _maxSize)
+		return false;
+
+	pixels = new GLubyte[newSize*newSize];
+	memset(pixels, 0, newSize*newSize*sizeof(GLubyte));
+	for (row = 0; row < _size; ++row) {
+		memcpy(&pixels[row*newSize], &_pixels[row*_size], _size);
+	}
+	delete[] _pixels;
+	_pixels = pixels;
+
+	for (iter = _shelves.begin(); iter != _shelves.end(); ++iter) {
+		if (!iter->free.empty()) {
+			last = --iter->free.end();
+			if (last->first + last->second == _size) {
+				last->second += newSize - _size;
+				continue;
+			}
+		}
+		iter->free[_size] = newSize - _size;
+	}
+
+	_size = newSize;
+	_resized = true;
+	_generation += 1;
+	return true;
+}
+
+/**
+ * Copies a bitmap into a region of the CPU atlas, clearing whatever it held before and
+ * clipping the bitmap to the region
+ * @param region The region to write to
+ * @param bitmap The first row of the bitmap
+ * @param pitch Distance between rows of the bitmap, in bytes
+ * @param width Width of the bitmap, in pixels
+ * @param rows Height of the bitmap, in pixels
+ * @param top Row of the region that the first row of the bitmap goes to, which may be negative
+ */
+void gui2d::GlyphAtlas::write(const gui2d::GlyphAtlas::Region& region, const GLubyte *bitmap, int pitch, int width, int rows, int top) {
+	Shelf& s = _shelves[region.shelf];
+	int row, dst;
+
+	width = std::min(width, region.width);
+
+	// The shelf may be taller than the region, and a previous region may have been taller; the
+	// padding is cleared and uploaded too, since filtering may sample it
+	for (row = 0; row < s.height; ++row) {
+		memset(&_pixels[(region.y + row)*_size + region.x], 0, region.width + PADDING);
+	}
+
+	for (row = 0; row < rows; ++row) {
+		dst = top + row;
+		if (dst < 0 || dst >= region.height)
+			continue;
+		memcpy(&_pixels[(region.y + dst)*_size + region.x], &bitmap[row*pitch], width);
+	}
+
+	if (s.dirtyMin < 0 || region.x < s.dirtyMin)
+		s.dirtyMin = region.x;
+	s.dirtyMax = std::max(s.dirtyMax, region.x + region.width + PADDING);
+}
+
+/**
+ * Pushes the changes since the last flush to the texture. The whole atlas is uploaded
+ * at once if it has no storage at its current size yet; otherwise each modified shelf
+ * uploads its modified span with one call.
+ */
+void gui2d::GlyphAtlas::flush(void) {
+	std::vector<Shelf>::iterator iter;
+	bool bound = false;
+
+	if (_resized) {
+		glBindTexture(GL_TEXTURE_2D, _texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, _size, _size, 0, GL_RED, GL_UNSIGNED_BYTE, _pixels);
+
+		for (iter = _shelves.begin(); iter != _shelves.end(); ++iter) {
+			iter->dirtyMin = -1;
+			iter->dirtyMax = -1;
+		}
+		_resized = false;
+		return;
+	}
+
+	for (iter = _shelves.begin(); iter != _shelves.end(); ++iter) {
+		if (iter->dirtyMin < 0)
+			continue;
+
+		if (!bound) {
+			glBindTexture(GL_TEXTURE_2D, _texture);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, _size);
+			bound = true;
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, iter->dirtyMin, iter->y, iter->dirtyMax - iter->dirtyMin, iter->height,
+						GL_RED, GL_UNSIGNED_BYTE, &_pixels[iter->y*_size + iter->dirtyMin]);
+
+		iter->dirtyMin = -1;
+		iter->dirtyMax = -1;
+	}
+
+	if (bound)
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
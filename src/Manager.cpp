@@ -12,10 +12,14 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <list>
 #include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 // Project definitions
 #include "Shader.h"
@@ -25,15 +29,22 @@
 #include "2dgui/String.h"
 #include "2dgui/InputBox.h"
 #include "2dgui/Button.h"
-#include "2dgui/QuadTree.h"
+#include "2dgui/FlatQuadTree.h"
 #include "2dgui/QuadRenderer.h"
 #include "2dgui/TexturedQuadRenderer.h"
+#include "2dgui/TextRenderer.h"
+#include "2dgui/GlyphAtlas.h"
+#include "2dgui/FontLoader.h"
+#include "2dgui/MappedFile.h"
+#include "2dgui/TextureAtlas.h"
+#include "2dgui/UnifiedRenderer.h"
 
 /**
  * GUI Manager constructor initializes all of the tracking mechanisms
  * @param ge Pointer to the graphics engine that we care about for this manager
  */
-gui2d::Manager::Manager(GraphicsEngine *ge) : _init(false), _qr(0), _tqr(0), _ge(ge), _destructor(NONE) {
+gui2d::Manager::Manager(GraphicsEngine *ge) : _init(false), _options(0), _qr(0), _tqr(0), _atlas(0), _unifiedShader(0), _ur(0), _glyphAtlas(0), _text(0),
+		_distanceShader(0), _distanceAtlas(0), _distanceText(0), _fontLoader(0), _nextFontHandle(1), _ge(ge), _destructor(NONE) {
 	
 	glm::vec4 bounds = glm::vec4(0.0f);
 	bounds[iMBR::MIN_X] = -1.0f;
@@ -41,8 +52,9 @@ gui2d::Manager::Manager(GraphicsEngine *ge) : _init(false), _qr(0), _tqr(0), _ge
 	bounds[iMBR::MIN_Y] = -1.0f;
 	bounds[iMBR::MAX_Y] = 1.0f;
 
-	_mouseHandlers = new QuadTree<iMouseHandler>(bounds, 0, 1);
-	_mouseMotionHandlers = new QuadTree<iMouseMotionHandler>(bounds, 0, 1);
+	_mouseHandlers = new FlatQuadTree<iMouseHandler>(bounds);
+	_mouseMotionHandlers = new FlatQuadTree<iMouseMotionHandler>(bounds);
+	_mouseDepth = 0;
 }
 
 /**
@@ -50,15 +62,15 @@ gui2d::Manager::Manager(GraphicsEngine *ge) : _init(false), _qr(0), _tqr(0), _ge
  */
 gui2d::Manager::~Manager() {
 	gui2d::FontMapIter fontIter;
+	gui2d::DistanceFontMapIter distanceIter;
+	gui2d::MappedFileMapIter archiveIter;
 	gui2d::FontStringListIter sListIter;
 	gui2d::StringListIter stringIter;
 	gui2d::StringList* sList;
 	gui2d::ButtonListIter buttonIter;
 
-	// Clean up the global renderer resources
-	if (_init) {
-		FT_Done_FreeType(_ft);
-	}
+	// Stop rasterizing fonts before anything they would be added to goes away
+	delete _fontLoader;
 
 	// Delete input mappings
 	delete _mouseHandlers;
@@ -70,6 +82,10 @@ gui2d::Manager::~Manager() {
 	// Free the sub-renderers
 	free(_qr);
 	free(_tqr);
+	delete _ur;
+	delete _atlas;
+	delete _text;
+	delete _distanceText;
 
 	// Delete all the displayed strings and their container lists
 	_destructor = STRINGS;
@@ -85,6 +101,23 @@ gui2d::Manager::~Manager() {
 	for (fontIter = _fonts.begin(); fontIter != _fonts.end(); fontIter++) {
 		delete (*fontIter).second;
 	}
+	for (distanceIter = _distanceFonts.begin(); distanceIter != _distanceFonts.end(); ++distanceIter) {
+		delete distanceIter->second;
+	}
+
+	// The fonts close the faces they opened on our library as they are deleted
+	if (_init) {
+		FT_Done_FreeType(_ft);
+	}
+
+	// Faces opened from archives read them until the fonts are gone
+	for (archiveIter = _archives.begin(); archiveIter != _archives.end(); ++archiveIter) {
+		delete archiveIter->second;
+	}
+
+	// The fonts return their glyphs to the atlases as they are deleted
+	delete _glyphAtlas;
+	delete _distanceAtlas;
 }
 
 /**
@@ -92,14 +125,16 @@ gui2d::Manager::~Manager() {
  * @param screenWidth The width of the screen we're drawing to, in pixels.
  * @param screenHeight The height of the screen we're drawing to, in pixels.
  * @param err An output stream that can be used to write out errors that we detect during runtime.
+ * @param options Bitwise combination of the RENDER_* constants selecting optional rendering paths
  * @return True if we initialized successfully, false otherwise
  */
-bool gui2d::Manager::init(int screenWidth, int screenHeight, std::ostream& err) {
+bool gui2d::Manager::init(int screenWidth, int screenHeight, std::ostream& err, int options) {
 	// Successfully initializing the FreeType library is required
 	if (FT_Init_FreeType(&_ft)) {
 		err << "(gui2d::Manager::init()) Unable to initialize FreeType library!" << std::endl;
 		return false;
 	}
+	gui2d::Font::configureLibrary(_ft);
 
 	// Load and check our text shader
 	if (!(_textShader = Shader::load(gui2d::SHADER_TEXT_SLOT, "text.vert", "text.frag"))) {
@@ -131,16 +166,52 @@ bool gui2d::Manager::init(int screenWidth, int screenHeight, std::ostream& err)
 		return false;
 	}
 
-	// Save attribute locations for the text shader
-	_ts_in_vert = _textShader->getAttribLocation("in_vert");
-	_ts_in_tex = _textShader->getAttribLocation("in_tex");
-	_ts_tex = _textShader->getUniformLocation("tex");
-	_ts_color = _textShader->getUniformLocation("color");
-	_ts_un_z = _textShader->getUniformLocation("un_z");
-
 	// Create the quad renderers
 	_qr = new gui2d::QuadRenderer(_untexShader);
 	_tqr = new gui2d::TexturedQuadRenderer(_guiShader);
+	_atlas = new gui2d::TextureAtlas();
+
+	// Create the glyph atlas shared by all fonts, and the batch that draws every string
+	_glyphAtlas = new gui2d::GlyphAtlas();
+	_text = new gui2d::TextRenderer(_textShader, _glyphAtlas, &_strings);
+
+	// Distance field fonts are optional, so a missing shader only disables them
+	if (!(_distanceShader = Shader::load(gui2d::SHADER_TEXT_SDF_SLOT, "text.vert", "text_sdf.frag")) || !_distanceShader->link()) {
+		err << "(gui2d::Manager::init()) Failed to load distance field text shader program, distance field fonts disabled" << std::endl;
+	}
+	else {
+		_distanceAtlas = new gui2d::GlyphAtlas(GL_LINEAR);
+		_distanceText = new gui2d::TextRenderer(_distanceShader, _distanceAtlas, &_strings);
+	}
+
+	// Optionally stream quads through persistently mapped buffers, which needs ARB_buffer_storage
+	if (options & gui2d::RENDER_STREAMING) {
+		if (!_qr->enableStreaming() || !_tqr->enableStreaming() || !_text->enableStreaming() ||
+				(_distanceText && !_distanceText->enableStreaming())) {
+			err << "(gui2d::Manager::init()) ARB_buffer_storage is not available, quad streaming disabled" << std::endl;
+			options &= ~gui2d::RENDER_STREAMING;
+		}
+	}
+
+	// Optionally draw quads as instances, which needs ARB_base_instance to draw from an offset
+	if (options & gui2d::RENDER_INSTANCED) {
+		if (!_qr->enableInstancing() || !_tqr->enableInstancing()) {
+			err << "(gui2d::Manager::init()) ARB_base_instance is not available, quad instancing disabled" << std::endl;
+			options &= ~gui2d::RENDER_INSTANCED;
+		}
+	}
+
+	// Optionally draw everything in one z-sorted pass, keeping the separate renderers around
+	if (options & gui2d::RENDER_UNIFIED) {
+		if (!(_unifiedShader = Shader::load(gui2d::SHADER_UNIFIED_SLOT, "unified.vert", "unified.frag")) || !_unifiedShader->link()) {
+			err << "(gui2d::Manager::init()) Failed to load unified shader program, unified rendering disabled" << std::endl;
+			options &= ~gui2d::RENDER_UNIFIED;
+		}
+		else {
+			_ur = new gui2d::UnifiedRenderer(_unifiedShader);
+		}
+	}
+	_options = options;
 
 	// Save our screen information
 	_screenWidth = screenWidth;
@@ -168,13 +239,16 @@ void gui2d::Manager::prepare(void) {
 
 /**
  * Load in a font and store it for later use.
- * @param path An asset loader-compatible path for the font to load
+ * @param data An asset loader-compatible path for the font to load, or a buffer holding it
  * @param size Size of the font, in pixels, to load
+ * @param distanceField Draw the font from the face's distance field glyphs, which are shared by every size
  * @return The identifier for this font
  */
-int gui2d::Manager::loadFont(const std::string& path, int size) {
+int gui2d::Manager::loadFont(const gui2d::FontData& data, int size, bool distanceField) {
 	gui2d::Font* font;
-	gui2d::FontName fname = gui2d::FontName(path, size);
+	gui2d::Font* source;
+	// Distance field fonts are kept apart from bitmap fonts of the same size by negating it
+	gui2d::FontName fname = gui2d::FontName(data.name, distanceField ? -size : size);
 
 	// Library must be initialized first
 	if (!_init) {
@@ -188,29 +262,239 @@ int gui2d::Manager::loadFont(const std::string& path, int size) {
 		return _curFont;
 	}
 
-	// Attempt to load the font
-	font = gui2d::Font::loadFont(_nextFontId, this, path, size, *_err);
-	if (font == NULL) {
-		return -1;
+	// Attempt to load the font, or scale the distance fields for its face
+	if (distanceField) {
+		if (!(source = getDistanceFont(data))) {
+			return -1;
+		}
+		font = gui2d::Font::scaleFont(_nextFontId, source, size);
+	}
+	else {
+		font = gui2d::Font::loadFont(_nextFontId, this, _glyphAtlas, data, size, *_err);
+		if (font == NULL) {
+			return -1;
+		}
 	}
 
 	// Save and return
+	_curFont = addFont(fname, font);
+	return _curFont;
+}
+
+/**
+ * Stores a newly loaded font under the next id
+ * @param fname The name that the font was loaded with
+ * @param font The font, which must have been created with the next id
+ * @return The id of the font
+ */
+int gui2d::Manager::addFont(const gui2d::FontName& fname, gui2d::Font *font) {
 	_fontIds[fname] = _nextFontId;
 	_fonts[_nextFontId] = font;
 	_strings[_nextFontId] = new gui2d::StringList();
-	_curFont = _nextFontId;
 	_nextFontId += 1;
 	return font->getId();
 }
 
+/**
+ * Names the glyphs that a background job rasterizes for a font. Distance field fonts of every
+ * size share the glyphs of their face, so they share one job.
+ * @param fname The name of the requested font
+ * @return The name of the job, which is the font name unless it uses distance fields
+ */
+gui2d::FontName gui2d::Manager::getJobName(const gui2d::FontName& fname) {
+	return fname.second < 0 ? gui2d::FontName(fname.first, 0) : fname;
+}
+
+/**
+ * Start loading a font in the background. Its glyphs are rasterized by a pool of worker
+ * threads, and the font is only created, and its glyphs uploaded, when finishFont() or
+ * finishFonts() is called on this thread. Loads that need glyphs which are already being
+ * rasterized wait for the same job. Unlike loadFont(), this does not change the current font.
+ * @param data An asset loader-compatible path for the font to load, or a buffer holding it
+ * @param size Size of the font, in pixels, to load
+ * @param distanceField Draw the font from the face's distance field glyphs, which are shared by every size
+ * @return A handle to pass to finishFont(), or -1 if the manager is not initialized
+ */
+int gui2d::Manager::loadFontAsync(const gui2d::FontData& data, int size, bool distanceField) {
+	gui2d::FontName fname = gui2d::FontName(data.name, distanceField ? -size : size);
+	gui2d::FontName jname = getJobName(fname);
+	int handle;
+	unsigned int workers;
+
+	if (!_init) {
+		(*_err) << "(gui2d::Manager::loadFontAsync) Attempted to load a Font before initializing!" << std::endl;
+		return -1;
+	}
+
+	handle = _nextFontHandle;
+	_nextFontHandle += 1;
+
+	// Fonts that are already loaded, or whose distance fields are, need no rasterization
+	if (_fontIds.count(fname) == 1) {
+		_fontHandles[handle] = _fontIds[fname];
+		return handle;
+	}
+	if (distanceField && _distanceFonts.count(data.name) == 1) {
+		_fontHandles[handle] = addFont(fname, gui2d::Font::scaleFont(_nextFontId, _distanceFonts[data.name], size));
+		return handle;
+	}
+
+	_fontWaits[handle] = fname;
+	if (_fontJobs.count(jname) == 1) {
+		return handle;
+	}
+	_fontJobs[jname] = handle;
+
+	if (!_fontLoader) {
+		workers = std::thread::hardware_concurrency();
+		_fontLoader = new gui2d::FontLoader(std::min(std::max(workers, 1u), 4u));
+	}
+
+	_fontLoader->submit(handle, data, size, distanceField, _fontCache);
+	return handle;
+}
+
+/**
+ * Finish loading a font that was started with loadFontAsync(), creating it from its glyphs
+ * and uploading them to the atlas if that has not been done yet. Once this returns a font
+ * id, or -1, the handle is forgotten; use getFontId() to look the font up again.
+ * @param handle The handle returned by loadFontAsync()
+ * @param wait Block until the glyphs have been rasterized, rather than returning FONT_PENDING
+ * @return The font id, FONT_PENDING if the font is not ready and wait is false, or -1 if it failed to load
+ */
+int gui2d::Manager::finishFont(int handle, bool wait) {
+	FontHandleMap::iterator done = _fontHandles.find(handle);
+	FontWaitMap::iterator waiting;
+	FontJobMap::iterator job;
+	int id;
+
+	if (done == _fontHandles.end()) {
+		waiting = _fontWaits.find(handle);
+		if (waiting == _fontWaits.end() || !_fontLoader) {
+			return -1;
+		}
+
+		job = _fontJobs.find(getJobName(waiting->second));
+		if (job == _fontJobs.end()) {
+			return -1;
+		}
+
+		if (!wait && _fontLoader->isPending(job->second)) {
+			return gui2d::FONT_PENDING;
+		}
+
+		completeFont(job->second);
+		done = _fontHandles.find(handle);
+		if (done == _fontHandles.end()) {
+			return -1;
+		}
+	}
+
+	id = done->second;
+	_fontHandles.erase(done);
+	return id;
+}
+
+/**
+ * Finish loading every font whose glyphs have been rasterized in the background, without
+ * waiting for the others. This is called at the start of each frame, so that finished
+ * fonts are uploaded even if nobody asks for them.
+ */
+void gui2d::Manager::finishFonts(void) {
+	std::vector<int> handles;
+	std::vector<int>::iterator iter;
+
+	if (!_fontLoader) {
+		return;
+	}
+
+	_fontLoader->getFinished(handles);
+	for (iter = handles.begin(); iter != handles.end(); ++iter) {
+		completeFont(*iter);
+	}
+}
+
+/**
+ * Takes a job from the font loader, waiting for it if needed, and creates the fonts of every
+ * load waiting for it on this thread. The results are remembered for later calls to finishFont().
+ * @param handle The handle of the job
+ */
+void gui2d::Manager::completeFont(int handle) {
+	gui2d::FontLoader::Job *job = _fontLoader->take(handle);
+	gui2d::Font *font;
+	gui2d::Font *source = NULL;
+	gui2d::FontName fname, jname;
+	FontWaitMap::iterator waiter;
+	int id;
+
+	if (!job) {
+		return;
+	}
+
+	jname = getJobName(gui2d::FontName(job->data.name, job->distanceField ? -job->size : job->size));
+	_fontJobs.erase(jname);
+	(*_err) << job->error;
+
+	// Every size of a distance field face is scaled from the same glyphs
+	if (job->distanceField && !job->failed) {
+		if (_distanceFonts.count(job->data.name) == 1) {
+			source = _distanceFonts[job->data.name];
+		}
+		else if (!_distanceText) {
+			(*_err) << "(gui2d::Manager::finishFont) Distance field text shader is not available!" << std::endl;
+			source = NULL;
+		}
+		else {
+			source = gui2d::Font::loadFont(-1, this, _distanceAtlas, job->data, gui2d::Font::DISTANCE_SIZE, job->raster, *_err, true);
+			if (source) {
+				_distanceFonts[job->data.name] = source;
+			}
+		}
+	}
+
+	for (waiter = _fontWaits.begin(); waiter != _fontWaits.end(); ) {
+		if (getJobName(waiter->second) != jname) {
+			++waiter;
+			continue;
+		}
+
+		// The same font may have been loaded while this job was running
+		fname = waiter->second;
+		id = -1;
+		if (_fontIds.count(fname) == 1) {
+			id = _fontIds[fname];
+		}
+		else if (job->failed) {
+			id = -1;
+		}
+		else if (job->distanceField) {
+			if (source) {
+				id = addFont(fname, gui2d::Font::scaleFont(_nextFontId, source, -fname.second));
+			}
+		}
+		else {
+			font = gui2d::Font::loadFont(_nextFontId, this, _glyphAtlas, job->data, job->size, job->raster, *_err);
+			if (font) {
+				id = addFont(fname, font);
+			}
+		}
+
+		_fontHandles[waiter->first] = id;
+		_fontWaits.erase(waiter++);
+	}
+
+	delete job;
+}
+
 /**
  * Retrieve the ID used for a specific font+size combination
- * @param path Path name of the font, same as in loadFont()
+ * @param data Path name of the font, or its buffer, same as in loadFont()
  * @param size Pixel size of the font, same as in loadFont()
+ * @param distanceField Whether the font uses distance fields, same as in loadFont()
  * @return The font ID
  */
-int gui2d::Manager::getFontId(const std::string& path, int size) {
-	gui2d::FontName fname = gui2d::FontName(path, size);
+int gui2d::Manager::getFontId(const gui2d::FontData& data, int size, bool distanceField) {
+	gui2d::FontName fname = gui2d::FontName(data.name, distanceField ? -size : size);
 
 	if (_fontIds.count(fname) == 1) {
 		return _fontIds[fname];
@@ -218,6 +502,69 @@ int gui2d::Manager::getFontId(const std::string& path, int size) {
 	return -1;
 }
 
+/**
+ * Retrieve the distance field glyphs for a face, rasterizing them the first time the face
+ * is used at any size
+ * @param data An asset loader-compatible path for the font, or a buffer holding it
+ * @return The distance field font, or null if it could not be loaded
+ */
+gui2d::Font *gui2d::Manager::getDistanceFont(const gui2d::FontData& data) {
+	gui2d::Font *font;
+
+	if (_distanceFonts.count(data.name) == 1) {
+		return _distanceFonts[data.name];
+	}
+
+	if (!_distanceText) {
+		(*_err) << "(gui2d::Manager::loadFont) Distance field text shader is not available!" << std::endl;
+		return NULL;
+	}
+
+	font = gui2d::Font::loadFont(-1, this, _distanceAtlas, data, gui2d::Font::DISTANCE_SIZE, *_err, true);
+	if (font != NULL) {
+		_distanceFonts[data.name] = font;
+	}
+	return font;
+}
+
+/**
+ * Describe a font that is stored inside an archive, such as a packed asset file, so that it
+ * can be passed to loadFont() or loadFontAsync() without being copied out. Each archive is
+ * mapped the first time one of its fonts is requested, and stays mapped until the manager
+ * is destroyed, since fonts read their faces from it whenever they need another glyph.
+ * @param archive Path to the archive file
+ * @param offset Offset of the font file within the archive, in bytes
+ * @param length Size of the font file, in bytes
+ * @param data Filled in with the font's buffer, named after the archive and offset
+ * @return True if the archive was mapped and holds the whole font
+ */
+bool gui2d::Manager::mapFont(const std::string& archive, size_t offset, size_t length, gui2d::FontData& data) {
+	gui2d::MappedFile *file;
+	std::ostringstream name;
+
+	if (_archives.count(archive) == 1) {
+		file = _archives[archive];
+	}
+	else {
+		file = new gui2d::MappedFile();
+		if (!file->open(archive)) {
+			(*_err) << "(gui2d::Manager::mapFont) Could not map font archive: " << archive << std::endl;
+			delete file;
+			return false;
+		}
+		_archives[archive] = file;
+	}
+
+	if (offset > file->getSize() || length > file->getSize() - offset) {
+		(*_err) << "(gui2d::Manager::mapFont) Font lies outside of archive: " << archive << std::endl;
+		return false;
+	}
+
+	name << archive << "@" << offset;
+	data = gui2d::FontData(name.str(), file->getData() + offset, length);
+	return true;
+}
+
 /**
  * Retrieve the font stored for a specific ID
  * @param fontId The ID to retrieve
@@ -266,15 +613,30 @@ void gui2d::Manager::textureRemoveRef(GLuint textureId) {
 }
 
 /**
- * Texture initialization hook called by the texture reference counter
+ * Texture initialization hook called by the texture reference counter. Small images are packed
+ * into the texture atlas instead of getting a texture of their own.
  * @param[in] name The "name" of the texture--this should be a path that can be passed to the asset loader
- * @param[out] tId The id assigned by OpenGL is saved here
+ * @param[out] tId The id assigned by OpenGL, or the atlas handle, is saved here
  * @todo Use AssetLoader to source image files for DevIL
  */
 void gui2d::Manager::createTexture(const std::string& name, GLuint& tId) {
 	ILuint iId;
 	ILint w, h;
 
+	// Load the image with DevIL
+	ilGenImages(1, &iId);
+	ilBindImage(iId);
+	ilLoadImage(name.c_str());
+	ilConvertImage(IL_RGBA, IL_UNSIGNED_BYTE);
+	w = ilGetInteger(IL_IMAGE_WIDTH);
+	h = ilGetInteger(IL_IMAGE_HEIGHT);
+
+	if (TextureAtlas::fits(w, h)) {
+		tId = TextureAtlas::getSingleton().add(ilGetData(), w, h);
+		ilDeleteImages(1, &iId);
+		return;
+	}
+
 	// Create a new texture
 	glGenTextures(1, &tId);
 	glBindTexture(GL_TEXTURE_2D, tId);
@@ -285,97 +647,120 @@ void gui2d::Manager::createTexture(const std::string& name, GLuint& tId) {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	// Load the image with DevIL
-	ilGenImages(1, &iId);
-	ilBindImage(iId);
-	ilLoadImage(name.c_str());
-	w = ilGetInteger(IL_IMAGE_WIDTH);
-	h = ilGetInteger(IL_IMAGE_HEIGHT);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ilGetData());
 	ilDeleteImages(1, &iId);
 }
 
 /**
  * Cleanup hook called by the texture reference counter
- * @param tId The OpenGL-given texture Id
+ * @param tId The OpenGL-given texture Id, or the atlas handle
  */
 void gui2d::Manager::cleanupTexture(GLuint& tId) {
+	if (TextureAtlas::isHandle(tId)) {
+		TextureAtlas::getSingleton().remove(tId);
+		return;
+	}
+
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glDeleteTextures(1, &tId);
 }
 
 /**
- * Accepts mouse click events and forwards them to active handlers
+ * Retrieve the storage for the handlers under the cursor at the current dispatch depth, so
+ * that a handler which dispatches another mouse event does not overwrite the list that is
+ * being iterated. Storage is kept between events, and a deque never moves the lists it holds.
+ * @return List of handlers to fill, reserved for MOUSE_SCRATCH handlers
+ */
+std::vector<gui2d::iMouseHandler *>& gui2d::Manager::getMouseScratch(void) {
+	if (_mouseDepth == static_cast<int>(_mouseScratch.size())) {
+		_mouseScratch.push_back(std::vector<iMouseHandler *>());
+		_mouseScratch.back().reserve(MOUSE_SCRATCH);
+	}
+	return _mouseScratch[_mouseDepth];
+}
+
+/**
+ * Accepts mouse click events and forwards them to the handlers under the cursor, from the
+ * topmost down, until one of them handles it
  * @param e The mouse event struct
  * @param id The pressed button ID
  * @return True if processing should continue, false if this click was handled
  */
 bool gui2d::Manager::mousePressed(const OIS::MouseEvent& e, OIS::MouseButtonID id) {
 	float x, y;
-	std::vector<iMouseHandler *> handlers;
 	std::vector<iMouseHandler *>::iterator iter;
 	int found;
 	input::Cursor& c = _ge->getCursor();
 	Ogre::Vector2 mp = c.getPosition();
+	std::vector<iMouseHandler *>& handlers = getMouseScratch();
 
 	// Convert the 0,1 normalized coordinates to -1,1
 	x = 2.0f * (mp.x - 0.5f);
 	y = 2.0f * (0.5f - mp.y);
 
-	// Get mouse handlers
-	found = _mouseHandlers->locate(x, y, handlers);
+	// Get mouse handlers, from the topmost down, into storage that is kept between events
+	handlers.clear();
+	found = _mouseHandlers->locateTopmost(x, y, handlers);
 
 	if(!found) {
 		return false;
 	}
 
+	// A handler may dispatch another mouse event, which locates into the next storage
+	_mouseDepth += 1;
 	iter = handlers.begin();
 	while (iter != handlers.end()) {
 		if (!(*iter)->mousePressed(x, y, id)) {
-			return false;
+			break;
 		}
 		
 		++iter;
 	}
+	_mouseDepth -= 1;
 
-	return true;
+	return iter == handlers.end();
 }
 
 /**
- * Accepts mouse click events and forwards them to active handlers
+ * Accepts mouse click events and forwards them to the handlers under the cursor, from the
+ * topmost down, until one of them handles it
  * @param e The mouse event struct
  * @param id The pressed button ID
  * @return True if processing should continue, false if this click was handled
  */
 bool gui2d::Manager::mouseReleased(const OIS::MouseEvent& e, OIS::MouseButtonID id) {
 	float x, y;
-	std::vector<iMouseHandler *> handlers;
 	std::vector<iMouseHandler *>::iterator iter;
 	int found;
 	input::Cursor& c = _ge->getCursor();
 	Ogre::Vector2 mp = c.getPosition();
+	std::vector<iMouseHandler *>& handlers = getMouseScratch();
 
 	// Convert the 0,1 normalized coordinates to -1,1
 	x = 2.0f * (mp.x - 0.5f);
 	y = 2.0f * (0.5f - mp.y);
 
-	// Get mouse handlers
-	found = _mouseHandlers->locate(x, y, handlers);
+	// Get mouse handlers, from the topmost down, into storage that is kept between events
+	handlers.clear();
+	found = _mouseHandlers->locateTopmost(x, y, handlers);
 
 	if(!found) {
 		return false;
 	}
 
+	// A handler may dispatch another mouse event, which locates into the next storage
+	_mouseDepth += 1;
 	iter = handlers.begin();
 	while (iter != handlers.end()) {
 		if (!(*iter)->mouseReleased(x, y, id)) {
-			return false;
+			break;
 		}
 		
 		++iter;
 	}
+	_mouseDepth -= 1;
 
-	return true;
+	return iter == handlers.end();
 }
 
 /**
@@ -472,6 +857,9 @@ gui2d::InputBox *gui2d::Manager::createInputBox(int fontId, float normX, float n
 void gui2d::Manager::removeString(gui2d::String *s) {
 	if (_destructor != STRINGS && _strings.count(s->getFont()->getId()) == 1) {
 		_strings[s->getFont()->getId()]->remove(s);
+		_text->hide(s);
+		if (_distanceText)
+			_distanceText->hide(s);
 	}
 }
 
@@ -497,34 +885,121 @@ void gui2d::Manager::hideQuads(iUntexturedQuadRenderable *r) {
 void gui2d::Manager::render(void) {
 	prepare();
 
+	// Pick up fonts that finished rasterizing in the background
+	finishFonts();
+
+	// Repack the atlas before textured quads copy their coordinates for this frame
+	_atlas->update();
+
+	// Likewise make room for glyphs that did not fit last frame before strings copy theirs
+	_glyphAtlas->update();
+	if (_distanceAtlas)
+		_distanceAtlas->update();
+
+	if (_ur) {
+		renderUnified();
+		return;
+	}
+
 	_qr->render();
 	_tqr->render();
 	renderText();
 }
 
 /**
- * Render all of the strings, sorted by font type in order to minimize texture binds
+ * Render every visible quad and string in a single z-sorted pass
  */
-void gui2d::Manager::renderText(void) {
+void gui2d::Manager::renderUnified(void) {
+	QuadRenderer::RenderableSet::const_iterator quadIter;
+	TexturedQuadRenderer::RenderableSet::const_iterator texIter;
+	FontStringListIter fontIter;
 	StringListIter iter;
-	FontMapIter fontIter;
-	StringList* strings;
 
-	// Activate our text shader
-	_textShader->use();
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(_ts_tex, 0);
+	_ur->begin();
+
+	for (quadIter = _qr->getRenderables().begin(); quadIter != _qr->getRenderables().end(); ++quadIter) {
+		_ur->add(quadIter->second);
+	}
 
-	// For each font we have loaded, render all strings at once to minimize texture rebinding
-	for (fontIter = _fonts.begin(); fontIter != _fonts.end(); ++fontIter) {
-		glBindTexture(GL_TEXTURE_2D, (*fontIter).second->getTextureId());
+	for (texIter = _tqr->getRenderables().begin(); texIter != _tqr->getRenderables().end(); ++texIter) {
+		_ur->add(texIter->second);
+	}
 
-		strings = _strings[(*fontIter).first];
-		for (iter = strings->begin(); iter != strings->end(); iter++) {
-			(*iter)->render();
+	for (fontIter = _strings.begin(); fontIter != _strings.end(); ++fontIter) {
+		for (iter = fontIter->second->begin(); iter != fontIter->second->end(); ++iter) {
+			_ur->add(*iter);
 		}
 	}
 
-	// Deactive the text shader
-	glUseProgram(0);
+	// Strings may have rasterized new glyphs while being added
+	glActiveTexture(GL_TEXTURE0);
+	_glyphAtlas->flush();
+	if (_distanceAtlas)
+		_distanceAtlas->flush();
+
+	_ur->render();
+}
+
+/**
+ * Retrieve the amount of quad data that the quad renderers pushed to the GPU during the last frame
+ * @return Number of bytes uploaded by the untextured and textured quad renderers combined
+ */
+size_t gui2d::Manager::getQuadBytesUploaded(void) const {
+	if (_ur)
+		return _ur->getBytesUploaded();
+	return _qr->getBytesUploaded() + _tqr->getBytesUploaded();
+}
+
+/**
+ * Retrieve the number of draw calls that the quad renderers issued during the last frame
+ * @return Number of draw calls by the untextured and textured quad renderers combined
+ */
+uint32_t gui2d::Manager::getQuadDrawCalls(void) const {
+	if (_ur)
+		return _ur->getDrawCalls();
+	return _qr->getDrawCalls() + _tqr->getDrawCalls();
+}
+
+/**
+ * Render all of the strings, with one draw call for bitmap fonts and one for distance field fonts
+ */
+void gui2d::Manager::renderText(void) {
+	_text->render();
+	if (_distanceText)
+		_distanceText->render();
+}
+
+/**
+ * Retrieve the number of draw calls that the text renderers issued during the last frame
+ * @return Number of draw calls for text, at most two
+ */
+uint32_t gui2d::Manager::getTextDrawCalls(void) const {
+	if (_ur)
+		return 0;
+	if (_distanceText)
+		return _text->getDrawCalls() + _distanceText->getDrawCalls();
+	return _text->getDrawCalls();
+}
+
+/**
+ * Set the outline drawn around all distance field text. Bitmap fonts and the unified pass
+ * do not draw outlines.
+ * @param width Width of the outline as a fraction of Font::DISTANCE_SPREAD, or zero for none
+ * @param color Color of the outline
+ */
+void gui2d::Manager::setTextOutline(float width, glm::vec4 color) {
+	if (_distanceText)
+		_distanceText->setOutline(width, color);
+}
+
+/**
+ * Set the drop shadow drawn behind all distance field text. Bitmap fonts and the unified pass
+ * do not draw shadows.
+ * @param offset Offset of the shadow in pixels at Font::DISTANCE_SIZE, with positive y moving
+ *				 it down, and no larger than Font::DISTANCE_SPREAD
+ * @param color Color of the shadow, with an alpha of zero for none
+ */
+void gui2d::Manager::setTextShadow(glm::vec2 offset, glm::vec4 color) {
+	if (_distanceText)
+		_distanceText->setShadow(offset, color);
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+/**
+ * @file 2dgui/MappedFile.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/MappedFile.h"
+
+/**
+ * Creates an empty mapping; call open() to map a file
+ */
+gui2d::MappedFile::MappedFile(void) : _data(NULL), _size(0) {
+#ifdef _WIN32
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+#endif
+}
+
+/**
+ * Unmaps the file, if one is open
+ */
+gui2d::MappedFile::~MappedFile(void) {
+	close();
+}
+
+/**
+ * Maps a file into memory for reading, replacing any file that was mapped before. Empty
+ * files cannot be mapped.
+ * @param path Path to the file
+ * @return True if the file was mapped
+ */
+bool gui2d::MappedFile::open(const std::string& path) {
+	close();
+
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+		close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL) {
+		close();
+		return false;
+	}
+
+	_data = static_cast<const unsigned char *>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (_data == NULL) {
+		close();
+		return false;
+	}
+	_size = static_cast<size_t>(size.QuadPart);
+#else
+	struct stat info;
+	void *data;
+	int fd;
+
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &info) || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file alive, so the descriptor is not needed afterwards
+	data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	_data = static_cast<const unsigned char *>(data);
+	_size = info.st_size;
+#endif
+
+	return true;
+}
+
+/**
+ * Unmaps the file, invalidating any pointers into it
+ */
+void gui2d::MappedFile::close(void) {
+#ifdef _WIN32
+	if (_data)
+		UnmapViewOfFile(_data);
+	if (_mapping)
+		CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data)
+		munmap(const_cast<unsigned char *>(_data), _size);
+#endif
+
+	_data = NULL;
+	_size = 0;
+}
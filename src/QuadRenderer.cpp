@@ -21,22 +21,11 @@
  */
 gui2d::QuadRenderer::QuadRenderer(Shader *s) : QuadRendererBase<gui2d::QuadRenderer, gui2d::iUntexturedQuadRenderable>(s), _vColors(0) {
 	// Get shader attribute location information
-	int s_vert = s->getAttribLocation("in_vert");
-	int s_color = s->getAttribLocation("in_color");
+	_s_color = s->getAttribLocation("in_color");
 
 	// Create buffers
-	glBindVertexArray(_vao);
 	glGenBuffers(1, &_colorVBO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
-	glVertexAttribPointer(s_vert, 3, GL_SHORT, GL_TRUE, sizeof(glm::i16vec3), 0);
-	glEnableVertexAttribArray(s_vert);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _colorVBO);
-	glVertexAttribPointer(s_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(glm::u8vec4), 0);
-	glEnableVertexAttribArray(s_color);
-
-	glBindVertexArray(0);
+	bindBufferAttributes();
 }
 
 /**
@@ -58,32 +47,94 @@ gui2d::QuadRenderer::~QuadRenderer(void) {
  * performed.
  * @param quads The number of quads we need to be able to store
  */
-void gui2d::QuadRenderer::resizeBuffers(uint16_t quads) {
-	_vColors = static_cast<glm::u8vec4 *>(realloc(_vColors, quads*4*sizeof(glm::u8vec4)));
+void gui2d::QuadRenderer::resizeBuffers(uint32_t quads) {
+	_vColors = static_cast<glm::u8vec4 *>(realloc(_vColors, quads*getAttribSize()));
+}
+
+/**
+ * Points the vertex and color attributes at the given buffers
+ * @param vertexBuffer The buffer holding vertex coordinates, starting at offset zero
+ * @param colorBuffer The buffer holding vertex colors
+ * @param colorOffset Byte offset of the first color within colorBuffer
+ */
+void gui2d::QuadRenderer::bindAttributes(GLuint vertexBuffer, GLuint colorBuffer, GLintptr colorOffset) {
+	glBindVertexArray(_vao);
+	bindVertexAttributes(vertexBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+	glVertexAttribPointer(_s_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(glm::u8vec4), reinterpret_cast<GLvoid *>(colorOffset));
+	glVertexAttribDivisor(_s_color, _instanced ? 1 : 0);
+	glEnableVertexAttribArray(_s_color);
+
+	glBindVertexArray(0);
+}
+
+/**
+ * Points the vertex attributes at our ordinary (non-streaming) vertex buffer objects
+ */
+void gui2d::QuadRenderer::bindBufferAttributes(void) {
+	bindAttributes(_vbo[0], _colorVBO, 0);
 }
 
 /**
  * Passes the render call forward to one item pointed to by an iterator
  * @param iter The iterator pointing to the item to pass render() to
  * @param offset The array offset to use
+ * @param force Should the item copy its data even if it has not changed
  * @return Passes back the iterator's render response
  */
-bool gui2d::QuadRenderer::renderItem(RenderableIter& iter, uint16_t offset) {
-	return (*iter)->render(&_vCoords[4*offset], &_vColors[4*offset], offset, false);
+bool gui2d::QuadRenderer::renderItem(RenderableIter& iter, uint32_t offset, bool force) {
+	if (_instanced)
+		return iter->second->renderInstance(&_vCoords[2*offset], &_vColors[offset], offset, force);
+	return iter->second->render(&_vCoords[4*offset], &_vColors[4*offset], offset, force);
+}
+
+/**
+ * Writes one item directly into a region of the streaming buffer
+ * @param iter The iterator pointing to the item to pass render() to
+ * @param vCoords Start of the vertex coordinates for the current region
+ * @param attribs Start of the vertex colors for the current region
+ * @param offset The quad offset to use within the region
+ */
+void gui2d::QuadRenderer::streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset) {
+	glm::u8vec4 *vColors = reinterpret_cast<glm::u8vec4 *>(attribs);
+	if (_instanced)
+		iter->second->renderInstance(&vCoords[2*offset], &vColors[offset], offset, true);
+	else
+		iter->second->render(&vCoords[4*offset], &vColors[4*offset], offset, true);
+}
+
+/**
+ * Re-specifies the color vbo on the gpu so that it can hold a given number of quads. Its
+ * contents are undefined until the next call to updateBuffers()
+ * @param quads The number of quads the vbo must be able to hold
+ */
+void gui2d::QuadRenderer::reserveBuffers(uint32_t quads) {
+	glBindBuffer(GL_ARRAY_BUFFER, _colorVBO);
+	glBufferData(GL_ARRAY_BUFFER, quads*getAttribSize(), 0, GL_DYNAMIC_DRAW);
 }
 
 /**
- * Pushes color buffer data to the gpu, overwriting the already loaded vbo for colors
+ * Pushes a range of color data to the gpu, overwriting that part of the vbo for colors
+ * @param first The first quad to upload
+ * @param quads The number of quads to upload
+ * @return The number of bytes uploaded
  */
-void gui2d::QuadRenderer::updateBuffers(void) {
+size_t gui2d::QuadRenderer::updateBuffers(uint32_t first, uint32_t quads) {
 	glBindBuffer(GL_ARRAY_BUFFER, _colorVBO);
-	glBufferData(GL_ARRAY_BUFFER, _count*sizeof(glm::u8vec4)*4, _vColors, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, first*getAttribSize(), quads*getAttribSize(),
+					reinterpret_cast<GLubyte *>(_vColors) + first*getAttribSize());
+	return quads*getAttribSize();
 }
 
 /**
  * Draws the data pointed to by our index buffer, which happens in one call for the untextured
- * stuff.
+ * stuff. Instanced quads are likewise drawn in one call.
  */
 void gui2d::QuadRenderer::drawElements(void) {
-	glDrawElements(GL_TRIANGLES, 6*_count, GL_UNSIGNED_SHORT, 0);
+	if (_instanced)
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, _count, _baseInstance);
+	else
+		glDrawElementsBaseVertex(GL_TRIANGLES, 6*_count, _indexType, 0, _baseVertex);
+	_drawCalls += 1;
 }
@@ -36,11 +36,18 @@ gui2d::Statistics::Statistics(GraphicsEngine *ge, gui2d::Manager *m, int fontId)
 	_y = -1.0f + 1*py;
 
 	// Create the strings
-	_fpsDisplay = _m->createString(fontId, "FPS: <>", _x, _y);
-	_glPrimitives = _m->createString(fontId, "GL Primitives: <>", _x, _fpsDisplay->getY() + _fpsDisplay->getHeightf());
-	_glSamples = _m->createString(fontId, "GL Samples: <>", _x, _glPrimitives->getY() + _glPrimitives->getHeightf());
-	_glTime = _m->createString(fontId, "GL Time: <>", _x, _glSamples->getY() + _glSamples->getHeightf());
-	_physicsTime = _m->createString(fontId, "Phys Time: <>", _x, _glTime->getY() + _glTime->getHeightf());
+	_fpsDisplay = _m->createString(fontId, "", _x, _y);
+	_glPrimitives = _m->createString(fontId, "", _x, _fpsDisplay->getY() + _fpsDisplay->getHeightf());
+	_glSamples = _m->createString(fontId, "", _x, _glPrimitives->getY() + _glPrimitives->getHeightf());
+	_glTime = _m->createString(fontId, "", _x, _glSamples->getY() + _glSamples->getHeightf());
+	_physicsTime = _m->createString(fontId, "", _x, _glTime->getY() + _glTime->getHeightf());
+
+	// Each value is a numeric field, so that updating it every frame only redraws the digits that changed
+	_fpsDisplay->drawField("FPS: ", FPS_SLOTS);
+	_glPrimitives->drawField("GL Primitives: ", COUNT_SLOTS);
+	_glSamples->drawField("GL Samples: ", COUNT_SLOTS);
+	_glTime->drawField("GL Time: ", TIME_SLOTS);
+	_physicsTime->drawField("Phys Time: ", TIME_SLOTS);
 
 	// Set strings to be the right colors
 	_fpsDisplay->setColor(glm::vec4(1.0f));
@@ -196,34 +203,15 @@ void gui2d::Statistics::setZ(GLushort z) {
  * @param ts The timestep since last update. This parameter is required for compatibility, but ignored
  */
 void gui2d::Statistics::update(float ts) {
-	std::stringstream ss;
-
 	if (_visible) {
 		// Update raw FPS
-		ss << _ge->getFPS();
-		_fpsDisplay->remove(5, 4);
-		_fpsDisplay->append(ss.str());
+		_fpsDisplay->setField(static_cast<double>(_ge->getFPS()), 1);
 
 		// Update extended stats
 		if (_extended) {
-			_glPrimitives->remove(15);
-			_glSamples->remove(12);
-			_glTime->remove(9);
-	
-			ss.str(std::string());
-			ss.clear();
-			ss << _ge->getPrimitivesGenerated();
-			_glPrimitives->append(ss.str());
-
-			ss.str(std::string());
-			ss.clear();
-			ss << _ge->getSamplesPassed();
-			_glSamples->append(ss.str());
-
-			ss.str(std::string());
-			ss.clear();
-			ss << _ge->getTimeElapsed()/1000;
-			_glTime->append(ss.str());
+			_glPrimitives->setField(static_cast<long>(_ge->getPrimitivesGenerated()));
+			_glSamples->setField(static_cast<long>(_ge->getSamplesPassed()));
+			_glTime->setField(static_cast<double>(_ge->getTimeElapsed()/1000), 2);
 		}
 	}
 }
@@ -234,9 +222,5 @@ void gui2d::Statistics::update(float ts) {
  * @param pt The physics time to update to, in usec
  */
 void gui2d::Statistics::setPhysicsTime(float pt) {
-	std::stringstream ss;
-
-	ss << pt;
-	_physicsTime->remove(11);
-	_physicsTime->append(ss.str());
+	_physicsTime->setField(static_cast<double>(pt), 2);
 }
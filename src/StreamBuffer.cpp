@@ -0,0 +1,118 @@
+/**
+ * @file 2dgui/StreamBuffer.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <gl/glew.h>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/StreamBuffer.h"
+
+/**
+ * The constructor does not allocate anything, call allocate() once the size is known
+ */
+gui2d::StreamBuffer::StreamBuffer(void) : _buffer(0), _mapped(0), _size(0), _region(0) {
+	int i;
+	for (i = 0; i < REGIONS; ++i) {
+		_fences[i] = 0;
+	}
+}
+
+/**
+ * Unmaps and deletes the buffer along with any outstanding fences
+ */
+gui2d::StreamBuffer::~StreamBuffer(void) {
+	release();
+}
+
+/**
+ * Frees the opengl resources that are held, leaving this ready to be allocated again
+ */
+void gui2d::StreamBuffer::release(void) {
+	int i;
+
+	for (i = 0; i < REGIONS; ++i) {
+		if (_fences[i]) {
+			glDeleteSync(_fences[i]);
+			_fences[i] = 0;
+		}
+	}
+
+	if (_buffer) {
+		glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glDeleteBuffers(1, &_buffer);
+	}
+
+	_buffer = 0;
+	_mapped = 0;
+	_size = 0;
+}
+
+/**
+ * Creates immutable storage of the given size and maps it persistently. Any previous
+ * storage is released; opengl keeps it alive until pending draws that use it complete.
+ * @param size Total number of bytes, covering every region
+ * @return True if the buffer was created and mapped, false otherwise
+ */
+bool gui2d::StreamBuffer::allocate(GLsizeiptr size) {
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	release();
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+	glBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+	_mapped = static_cast<GLubyte *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+
+	if (!_mapped) {
+		release();
+		return false;
+	}
+
+	_size = size;
+	_region = 0;
+	return true;
+}
+
+/**
+ * Advances to the next region in the ring, blocking until the GPU is done with it
+ * @return The region that may now be written
+ */
+int gui2d::StreamBuffer::nextRegion(void) {
+	GLenum result;
+
+	_region = (_region + 1) % REGIONS;
+
+	if (_fences[_region]) {
+		do {
+			result = glClientWaitSync(_fences[_region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		glDeleteSync(_fences[_region]);
+		_fences[_region] = 0;
+	}
+
+	return _region;
+}
+
+/**
+ * Places a fence after the draw calls that read the current region, so that it is not
+ * written again until they have completed
+ */
+void gui2d::StreamBuffer::fence(void) {
+	if (_fences[_region])
+		glDeleteSync(_fences[_region]);
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * Checks whether the current context can create persistently mapped buffers
+ * @return True if ARB_buffer_storage (or GL 4.4) is available
+ */
+bool gui2d::StreamBuffer::isSupported(void) {
+	return GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+}
@@ -4,12 +4,26 @@
  */
 
 // Standard headers
-// None
+#include <algorithm>
+#include <cstring>
 
 // Project definitions
 #include "2dgui/String.h"
 #include "2dgui/Manager.h"
 
+namespace {
+
+/**
+ * Orders byte offsets against the starts of wrapped lines, to find the line holding an offset
+ */
+struct StartsAfter {
+	bool operator()(int offset, const gui2d::String::Line& line) const {
+		return offset < line.start;
+	}
+};
+
+};
+
 /**
  * This is the only constructor that should be used, to configure the necessary
  * rendering information immediately.
@@ -24,15 +38,24 @@ gui2d::String::String(gui2d::Font* font) : _font(font) {
  * Initialization routine sets all of our default member variable data to avoid repeating it
  */
 void gui2d::String::init(void) {
-	_init = _gInit = _modified = false;
+	_init = _modified = _moved = false;
 	_x = _y = 0.0f;
-	_vertexCount = _indexCount = _strLen = _maxCount = 0;
+	_startX = _startY = _curX = 0;
+	_vertexCount = _strLen = _maxCount = _laidOut = 0;
+	_dirtyFirst = _dirtyEnd = 0;
+	_fieldPrefix = _fieldSlots = _fieldQuad = 0;
+	_fieldPen = _fieldAdvance = 0;
+	_wrapWidth = 0;
+	_lineHeight = 0;
+	_align = TEXT_ALIGN_LEFT;
+	_glyphGeneration = _font->getGeneration();
 	_color = glm::vec4(1.0f);
 	_bMinX = _bMinY = SHRT_MIN;
 	_bMaxX = _bMaxY = SHRT_MAX;
 	_vertcoords = NULL;
 	_texcoords = NULL;
-	_index = NULL;
+	_pens = NULL;
+	_quadStarts = NULL;
 }
 
 /**
@@ -44,16 +67,8 @@ gui2d::String::~String(void) {
 	if (_init) {
 		delete[] _vertcoords;
 		delete[] _texcoords;
-		delete[] _index;
-	}
-
-	if (_gInit) {
-		glBindVertexArray(0);
-		glDeleteVertexArrays(1, &_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glDeleteBuffers(2, _vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glDeleteBuffers(1, &_ibo);
+		delete[] _pens;
+		delete[] _quadStarts;
 	}
 }
 
@@ -67,15 +82,15 @@ bool gui2d::String::hasCapacity(int count) {
 }
 
 /**
- * Double the allocated space and copy the count elements to the new buffer
+ * Double the allocated space and copy the laid out characters to the new buffers
  * @param minCapacity The minimum capacity needed
- * @param copyCount The number of values to copy from the previous buffers
  */
-void gui2d::String::increaseCapacity(int minCapacity, int copyCount) {
+void gui2d::String::increaseCapacity(int minCapacity) {
 	int newCap = _maxCount*2;
-	glm::i16vec2 *newVert;
+	glm::i32vec2 *newVert;
 	glm::u16vec2 *newTex;
-	GLushort* newIndex;
+	GLint *newPens;
+	uint16_t *newQuadStarts;
 
 	if (_maxCount*2 < minCapacity)
 		newCap = minCapacity+1;
@@ -83,26 +98,35 @@ void gui2d::String::increaseCapacity(int minCapacity, int copyCount) {
 		newCap = _maxCount*2;
 
 	// Create new arrays
-	newVert = new glm::i16vec2[newCap*4];
+	newVert = new glm::i32vec2[newCap*4];
 	newTex = new glm::u16vec2[newCap*4];
-	newIndex = new GLushort[newCap*6];
+	newPens = new GLint[newCap+1];
+	newQuadStarts = new uint16_t[newCap+1];
 
 	// Copy over values
 	if (_init) {
-		memcpy(newVert, _vertcoords, copyCount*4*sizeof(glm::i16vec2));
-		memcpy(newTex, _texcoords, copyCount*4*sizeof(glm::u16vec2));
-		memcpy(newIndex, _index, copyCount*6*sizeof(GLushort));
+		memcpy(newVert, _vertcoords, _vertexCount*sizeof(glm::i32vec2));
+		memcpy(newTex, _texcoords, _vertexCount*sizeof(glm::u16vec2));
+		memcpy(newPens, _pens, (_laidOut+1)*sizeof(GLint));
+		memcpy(newQuadStarts, _quadStarts, (_laidOut+1)*sizeof(uint16_t));
 
 		// Clean up memory that we are ditching
 		delete[] _vertcoords;
 		delete[] _texcoords;
-		delete[] _index;
+		delete[] _pens;
+		delete[] _quadStarts;
+	}
+	else {
+		// An empty string has nothing laid out yet, but edits start from its first pen
+		newPens[0] = 0;
+		newQuadStarts[0] = 0;
 	}
 
 	// Save pointers
 	_vertcoords = newVert;
 	_texcoords = newTex;
-	_index = newIndex;
+	_pens = newPens;
+	_quadStarts = newQuadStarts;
 
 	// Update our maximum containable count
 	_maxCount = newCap;
@@ -126,6 +150,7 @@ gui2d::String& gui2d::String::translate(float normX, float normY) {
  */
 void gui2d::String::setOpacity(float alpha) {
 	_color.w = alpha;
+	_modified = true;
 }
 
 /**
@@ -137,26 +162,26 @@ void gui2d::String::setOpacity(GLubyte alpha) {
 }
 
 /**
- * Adjust this string's position, redrawing it in order to do so
+ * Adjust this string's position. The glyphs keep their layout and are only copied again at
+ * the new position, unless the string is clipped by its bounds before or after the move.
  * @param normX The new x position, in normalized coordinates
  * @param normY The new y position, in normalized coordinates
  * @return Reference to the string to allow chaining
  */
 gui2d::String& gui2d::String::setPosition(float normX, float normY) {
-	// Initialize our member variables for this string
-	_vertexCount = 0;
-	_indexCount = 0;
+	bool clipped = _laidOut < _strLen || (_fieldSlots > 0 && _vertexCount/4 < _fieldQuad + _fieldSlots);
 
 	// Calculate initial location based on normalized coordinates
-	_curX = static_cast<GLshort>(normX * (1 << 15));
-	_curY = static_cast<GLshort>(normY * (1 << 15));
+	_startX = static_cast<GLshort>(normX * (1 << 15));
+	_startY = static_cast<GLshort>(normY * (1 << 15));
 	_x = normX;
 	_y = normY;
-	_startX = _curX;
-	_startY = _curY;
 
-	// Actually draw the string now
-	findPenDraw(_source);
+	// Pens only move forward, so the string fits if its end does; wrapped text is not clipped
+	if (clipped || (!isWrapped() && _startX + _curX > _bMaxX))
+		relayout();
+	else
+		_moved = true;
 
 	return *this;
 }
@@ -187,6 +212,58 @@ void gui2d::String::setMaxY(float normMaxY) {
 		_bMaxY = static_cast<GLint>(normMaxY * (1 << 15));
 }
 
+/**
+ * Wraps the text into lines no wider than a maximum width, or stops wrapping it. Lines break
+ * after a run of spaces, or within a word that is too wide for a line of its own, and always
+ * at a newline. Wrapped text ignores the maximum x coordinate.
+ * @param maxWidth The widest that a line may be, in normalized coordinates, or zero to not wrap;
+ *			widths past that of the screen are treated as the whole screen
+ * @param align TEXT_ALIGN_* constant to align each line within the maximum width
+ * @param lineHeight Distance from one line to the next, in normalized coordinates, or zero
+ *			to use the font's height
+ * @return Reference to the string to allow chaining
+ */
+gui2d::String& gui2d::String::setWrap(float maxWidth, int align, float lineHeight) {
+	if (maxWidth > 0.0f)
+		_wrapWidth = static_cast<GLint>(std::min(maxWidth, 2.0f) * (1 << 15));
+	else
+		_wrapWidth = 0;
+
+	_align = align;
+	if (lineHeight > 0.0f)
+		_lineHeight = static_cast<GLint>(std::min(lineHeight, 2.0f) * (1 << 15));
+	else
+		_lineHeight = _font->getTexHeight();
+
+	relayout();
+	return *this;
+}
+
+/**
+ * Retrieve the width of the string, which is that of its widest line if it is wrapped
+ * @return The width in normalized coordinates
+ */
+float gui2d::String::getWidthf(void) const {
+	LineList::const_iterator iter;
+	GLint width = 0;
+
+	if (!isWrapped())
+		return _font->getStringWidthf(_source);
+
+	for (iter = _lines.begin(); iter != _lines.end(); ++iter) {
+		width = std::max(width, iter->width);
+	}
+	return width / static_cast<float>(1 << 15);
+}
+
+/**
+ * Retrieve the height of the string, from the top of its first line to the bottom of its last
+ * @return The height in normalized coordinates
+ */
+float gui2d::String::getHeightf(void) const {
+	return _font->getHeight() + (getLineCount() - 1) * _lineHeight / static_cast<float>(1 << 15);
+}
+
 /**
  * Draw the string from scratch, set init flag, save important rendering parameters, using
  * the saved x and y position data
@@ -205,30 +282,26 @@ void gui2d::String::drawText(const std::string& source) {
 void gui2d::String::drawText(const std::string& source, float normX, float normY) {
 	// Make sure our buffers are big enough to hold the desired string
 	if (!hasCapacity(source.length())) {
-		increaseCapacity(source.length()+1, 0);
+		_vertexCount = _laidOut = 0;
+		increaseCapacity(source.length()+1);
 	}
 
 	// Allocate some space, we need four unique vertices (+textures) per character (at most)
-	// in order to account for different texture mappings at "shared" vertices, and
-	// we need six indices to render the two triangles per character
+	// in order to account for different texture mappings at "shared" vertices
 	_strLen = source.length();
-	_maxCount = _strLen;
 
 	// Initialize our member variables for this string
-	_vertexCount = 0;
-	_indexCount = 0;
 	_source = std::string(source);
+	_fieldSlots = 0;
 
 	// Calculate initial location based on normalized coordinates
-	_curX = static_cast<GLshort>(normX * (1 << 15));
-	_curY = static_cast<GLshort>(normY * (1 << 15));
+	_startX = static_cast<GLshort>(normX * (1 << 15));
+	_startY = static_cast<GLshort>(normY * (1 << 15));
 	_x = normX;
 	_y = normY;
-	_startX = _curX;
-	_startY = _curY;
 
 	// Actually draw the string now
-	findPenDraw(source);
+	relayout();
 }
 
 /**
@@ -237,142 +310,543 @@ void gui2d::String::drawText(const std::string& source, float normX, float normY
  * @param ci Reference to character info struct for the character being drawn
  * @param curX The current X coordinate to draw the character at
  * @param curY The current Y coordinate to draw the character at
- * @param indexOffset The offset of the index buffer to write to for this character's quad
  * @param vertexOffset The offset of the vertex buffer to write to for this character's quad
  */
-void gui2d::String::drawChar(const gui2d::Font::char_info& ci, GLshort curX, GLshort curY, int indexOffset, int vertexOffset) {
-	GLshort mx, my;
+void gui2d::String::drawChar(const gui2d::Font::char_info& ci, GLint curX, GLint curY, int vertexOffset) {
+	GLint mx, my, top;
 
+	// Distance field glyphs extend past the font's height on both sides
 	mx = curX + ci.bl;
-	my = curY;
+	my = curY - _font->getPadding();
+	top = curY + _font->getTexHeight() + _font->getPadding();
 
 	// Skip empty characters (this means we don't render spaces, for instance)
 	if (ci.sbw == 0)
 		return;
 
 	// Set up vertex and texture coordinates, going counter clockwise
-	_index[indexOffset] = vertexOffset;
-	_index[indexOffset+3] = vertexOffset;
-	_vertcoords[vertexOffset] = glm::i16vec2(mx, my);
-	_texcoords[vertexOffset] = glm::u16vec2(ci.tx, USHRT_MAX);
+	_vertcoords[vertexOffset] = glm::i32vec2(mx, my);
+	_texcoords[vertexOffset] = glm::u16vec2(ci.tx, ci.tyEnd);
 
-	_index[indexOffset+1] = vertexOffset+1;
-	_vertcoords[vertexOffset+1] = glm::i16vec2(mx + ci.sbw, my);
-	_texcoords[vertexOffset+1] = glm::u16vec2(ci.txEnd, USHRT_MAX);
+	_vertcoords[vertexOffset+1] = glm::i32vec2(mx + ci.sbw, my);
+	_texcoords[vertexOffset+1] = glm::u16vec2(ci.txEnd, ci.tyEnd);
 
-	_index[indexOffset+2] = vertexOffset+2;
-	_index[indexOffset+4] = vertexOffset+2;
-	_vertcoords[vertexOffset+2] = glm::i16vec2(mx + ci.sbw, my + _font->getTexHeight());
-	_texcoords[vertexOffset+2] = glm::u16vec2(ci.txEnd, 0);
+	_vertcoords[vertexOffset+2] = glm::i32vec2(mx + ci.sbw, top);
+	_texcoords[vertexOffset+2] = glm::u16vec2(ci.txEnd, ci.ty);
 
-	_index[indexOffset+5] = vertexOffset+3;
-	_vertcoords[vertexOffset+3] = glm::i16vec2(mx, my + _font->getTexHeight());
-	_texcoords[vertexOffset+3] = glm::u16vec2(ci.tx, 0);
+	_vertcoords[vertexOffset+3] = glm::i32vec2(mx, top);
+	_texcoords[vertexOffset+3] = glm::u16vec2(ci.tx, ci.ty);
 }
 
 /**
- * Starting with the current values for all counts and positions, update our counts and pen location
- * for the current string (used to recalculate pen position when saving part of the string)
- * @param source The string to find the pen state for.
+ * Finds the codepoint that the character at an offset kerns against, which is the previous
+ * character unless that one is empty
+ * @param offset The byte offset of a character, which must begin a UTF-8 sequence
+ * @return The previous codepoint, or zero if there is none to kern against
  */
-void gui2d::String::findPen(const std::string& source) {
+uint32_t gui2d::String::getPrevious(int offset) {
+	const char *base = _source.c_str();
 	const char *c;
-	const char *p = 0;
+	uint32_t codepoint;
+	int i = offset - 1;
+
+	if (offset == 0)
+		return 0;
+
+	// Step back over continuation bytes to the start of the sequence
+	while (i > 0 && (base[i] & 0xC0) == 0x80) {
+		--i;
+	}
+
+	c = &base[i];
+	codepoint = Font::decodeUTF8(c);
+	if (_font->getCharInfo(codepoint)->sbw == 0)
+		return 0;
+	return codepoint;
+}
+
+/**
+ * Counts the quads that a piece of text draws, which is one for each non-empty character
+ * @param source The text to count
+ * @return The number of quads
+ */
+int gui2d::String::countQuads(const std::string& source) {
+	const char *c = source.c_str();
+	int quads = 0;
+
+	while (*c != 0) {
+		if (_font->getCharInfo(Font::decodeUTF8(c))->sbw != 0)
+			quads += 1;
+	}
+	return quads;
+}
+
+/**
+ * Lays out and draws a range of characters, starting from the pen and quad recorded for the
+ * first one, and records the same for each character after it. Drawing stops at the first
+ * character that would cross the bounds; the pen, vertex count, and laid out length are left
+ * wherever the layout stopped.
+ * @param start The byte offset of the first character, which must already have been reached
+ * @param end The byte offset to stop at
+ * @return True if every character fit within the bounds
+ */
+bool gui2d::String::layout(int start, int end) {
+	const char *base = _source.c_str();
+	const char *c = &base[start];
+	const char *next;
+	uint32_t codepoint, prev = getPrevious(start);
 	const gui2d::Font::char_info *ci;
 	GLint tempX = 0;
+	GLint pen = _pens[start];
+	int quad = _quadStarts[start];
+	bool kerning = _font->hasKerning();
+	bool fits = true;
 
-	for (c = source.c_str(); *c != 0; c++) {
-		ci = _font->getCharInfo(*c);
+	while (c < &base[end]) {
+		next = c;
+		codepoint = Font::decodeUTF8(next);
+		ci = _font->getCharInfo(codepoint);
 
 		// Account for kerning
-		if (p) {
-			tempX = static_cast<GLint>(_curX) + _font->getKerning(*p, *c) + ci->ax;
+		if (prev && kerning) {
+			tempX = pen + _font->getKerning(prev, codepoint) + ci->ax;
 		}
 		else {
-			tempX = static_cast<GLint>(_curX) + ci->ax;
+			tempX = pen + ci->ax;
 		}
 
 		// Check if we're going to go out of bounds by advancing our pointer, if so stop drawing
-		if (tempX > _bMaxX) {
-			return;
+		if (_startX + tempX > _bMaxX) {
+			fits = false;
+			break;
 		}
 
+		drawChar(*ci, pen, 0, 4*quad);
+
 		// Update our "pen" for where to start the next character
-		_curX = static_cast<GLshort>(tempX);
+		pen = tempX;
+		c = next;
 
+		// Skip empty characters (in either dimension, this means we don't render spaces, for instance)
 		if (ci->sbw == 0) {
-			// Disable kerning for next iteration
-			p = 0;
-			continue;
+			prev = 0;
+		}
+		else {
+			quad += 1;
+			prev = codepoint;
 		}
 
-		_vertexCount += 4;
-		_indexCount += 6;
-		p = c;
+		_pens[c - base] = pen;
+		_quadStarts[c - base] = static_cast<uint16_t>(quad);
 	}
+
+	_laidOut = c - base;
+	_curX = pen;
+	_vertexCount = 4*quad;
+	return fits;
 }
 
 /**
- * Same thing as the pen finding method, except this draws the string as well.
- * @param source The string to find the pen+draw for
+ * Lays the whole string out again from its start position, to be copied in full
  */
-void gui2d::String::findPenDraw(const std::string& source) {
-	const char *c;
-	const char *p = 0;
+void gui2d::String::relayout(void) {
+	_modified = true;
+	_glyphGeneration = _font->getGeneration();
+	_curX = 0;
+	_vertexCount = 0;
+	_laidOut = 0;
+
+	// Wrapped text always has at least one line, even if it is empty
+	if (_wrapWidth > 0) {
+		_lines.resize(1);
+		_lines[0].start = _lines[0].end = 0;
+		_lines[0].quad = 0;
+		_lines[0].width = 0;
+		_curX = alignLine(_lines[0]);
+	}
+
+	// Nothing has ever been allocated for an empty string
+	if (!_init)
+		return;
+
+	_pens[0] = 0;
+	_quadStarts[0] = 0;
+
+	if (_fieldSlots > 0) {
+		layoutField();
+	}
+	else if (_wrapWidth > 0) {
+		layoutLines(0);
+	}
+	else {
+		layout(0, _strLen);
+	}
+}
+
+/**
+ * Finds where a line ends, which is before the space run preceding the first word that does
+ * not fit, or before the first character that does not fit if the line holds no whole word.
+ * Kerning is measured the same way as in layout(), starting over on each line.
+ * @param line The line to break, whose start must be set; its end and width are filled in
+ * @param quads Filled in with the number of quads drawn on the line
+ * @return The byte offset that the next line starts at, past any spaces or newline skipped
+ */
+int gui2d::String::breakLine(gui2d::String::Line& line, int& quads) {
+	const char *base = _source.c_str();
+	const char *c = &base[line.start];
+	const char *next;
+	uint32_t codepoint, prev = 0;
 	const gui2d::Font::char_info *ci;
-	GLint tempX = 0;
+	GLint pen = 0, tempX, width = 0;
+	int breakAt = -1, breakQuads = 0, breakWidth = 0;
+	bool kerning = _font->hasKerning();
+	bool space = false;
+
+	quads = 0;
+	while (c < &base[_strLen] && *c != '\n') {
+		next = c;
+		codepoint = Font::decodeUTF8(next);
+		ci = _font->getCharInfo(codepoint);
+
+		if (prev && kerning)
+			tempX = pen + _font->getKerning(prev, codepoint) + ci->ax;
+		else
+			tempX = pen + ci->ax;
+
+		// Spaces may hang past the end of the line, and mark where it may be broken
+		if (codepoint == ' ') {
+			if (!space) {
+				breakAt = c - base;
+				breakQuads = quads;
+				breakWidth = width;
+			}
+		}
+		else if (tempX > _wrapWidth && c - base > line.start) {
+			if (breakAt > line.start) {
+				line.end = breakAt;
+				line.width = breakWidth;
+				quads = breakQuads;
+
+				// Spaces at the break are not drawn on either line
+				while (base[breakAt] == ' ')
+					++breakAt;
+				return breakAt;
+			}
+
+			line.end = c - base;
+			line.width = width;
+			return line.end;
+		}
 
-	_modified = true;
+		pen = tempX;
+		c = next;
+
+		if (ci->sbw == 0) {
+			prev = 0;
+		}
+		else {
+			quads += 1;
+			prev = codepoint;
+		}
 
-	for (c = source.c_str(); *c != 0; ++c) {
-		ci = _font->getCharInfo(*c);
+		space = (codepoint == ' ');
+		if (!space)
+			width = pen;
+	}
 
-		// Account for kerning
-		if (p) {
-			tempX = static_cast<GLint>(_curX) + _font->getKerning(*p, *c) + ci->ax;
+	line.end = c - base;
+	line.width = width;
+	return *c == '\n' ? line.end + 1 : line.end;
+}
+
+/**
+ * Finds where a line is drawn within the maximum width, according to the alignment
+ * @param line The line to align, whose width must be set
+ * @return The x position of the line's first pen, relative to the string's position
+ */
+GLint gui2d::String::alignLine(const gui2d::String::Line& line) const {
+	if (_align == TEXT_ALIGN_CENTER)
+		return (_wrapWidth - line.width) / 2;
+	else if (_align == TEXT_ALIGN_RIGHT)
+		return _wrapWidth - line.width;
+	return 0;
+}
+
+/**
+ * Draws the characters of one wrapped line into its quads, below the lines before it
+ * @param line The index of the line, which must already have been broken
+ */
+void gui2d::String::drawLine(int line) {
+	const Line& l = _lines[line];
+	const char *base = _source.c_str();
+	const char *c = &base[l.start];
+	uint32_t codepoint, prev = 0;
+	const gui2d::Font::char_info *ci;
+	GLint pen = alignLine(l);
+	GLint y = -line * _lineHeight;
+	int quad = l.quad;
+	bool kerning = _font->hasKerning();
+
+	while (c < &base[l.end]) {
+		codepoint = Font::decodeUTF8(c);
+		ci = _font->getCharInfo(codepoint);
+
+		drawChar(*ci, pen, y, 4*quad);
+
+		if (prev && kerning)
+			pen += _font->getKerning(prev, codepoint);
+		pen += ci->ax;
+
+		if (ci->sbw == 0) {
+			prev = 0;
 		}
 		else {
-			tempX = static_cast<GLint>(_curX) + ci->ax;
+			quad += 1;
+			prev = codepoint;
 		}
+	}
+}
 
-		// Check if we're going to go out of bounds by advancing our pointer, if so stop drawing
-		if (tempX > _bMaxX) {
-			return;
+/**
+ * Breaks and draws every line from one onwards, dropping the lines that were cached after it
+ * @param first The index of the first line to lay out, whose start and quad must be set
+ */
+void gui2d::String::layoutLines(int first) {
+	Line next;
+	int line, quads;
+
+	_lines.resize(first + 1);
+	for (line = first; ; ++line) {
+		next.start = breakLine(_lines[line], quads);
+		drawLine(line);
+
+		if (_lines[line].end == _strLen)
+			break;
+
+		next.quad = _lines[line].quad + quads;
+		_lines.push_back(next);
+	}
+
+	_vertexCount = 4*(_lines.back().quad + quads);
+	_laidOut = _strLen;
+	_curX = alignLine(_lines.back()) + _lines.back().width;
+}
+
+/**
+ * Replaces part of wrapped text, breaking lines again from the one before the edited word,
+ * which may take that word if it became shorter. Once a line starts at the same text that
+ * an old line did, every line after it breaks as it did before, so those lines' quads are only
+ * moved and shifted down by the change in the number of lines.
+ * @param start The byte offset to replace from, which must begin a UTF-8 sequence
+ * @param removed The number of bytes to remove
+ * @param inserted The text to insert in their place
+ */
+void gui2d::String::spliceLines(int start, int removed, const std::string& inserted) {
+	int diff = static_cast<int>(inserted.length()) - removed;
+	int editEnd = start + inserted.length();
+	int oldQuads = _vertexCount/4;
+	int first, firstQuad, line, old, quads, tailQuad, oldTailQuad, tailQuads, i;
+	GLint dy;
+	bool converged = false;
+	Line next;
+
+	// Step back to the line that the edited word starts on, past lines broken within it
+	first = std::upper_bound(_lines.begin(), _lines.end(), start, StartsAfter()) - _lines.begin() - 1;
+	while (first > 0 && _lines[first - 1].end == _lines[first].start)
+		first -= 1;
+	if (first > 0)
+		first -= 1;
+	firstQuad = _lines[first].quad;
+
+	_oldLines.swap(_lines);
+	_lines.assign(_oldLines.begin(), _oldLines.begin() + first + 1);
+
+	_source.replace(start, removed, inserted);
+	_strLen = _source.length();
+
+	old = first + 1;
+	for (line = first; ; ++line) {
+		next.start = breakLine(_lines[line], quads);
+		next.quad = _lines[line].quad + quads;
+
+		if (_lines[line].end == _strLen)
+			break;
+
+		// Old lines are found by their start before the edit, which only moved the text after it
+		while (old < static_cast<int>(_oldLines.size()) && _oldLines[old].start + diff < next.start)
+			++old;
+		if (next.start >= editEnd && old < static_cast<int>(_oldLines.size()) && _oldLines[old].start + diff == next.start) {
+			converged = true;
+			break;
 		}
 
-		drawChar(*ci, _curX, _curY, _indexCount, _vertexCount);
+		_lines.push_back(next);
+	}
 
-		// Update our "pen" for where to start the next character
-		_curX = static_cast<GLshort>(tempX);
+	if (converged) {
+		tailQuad = next.quad;
+		oldTailQuad = _oldLines[old].quad;
+		tailQuads = oldQuads - oldTailQuad;
+		dy = (old - line - 1) * _lineHeight;
+
+		// Move the kept lines into place before the new lines are drawn over where they were
+		memmove(&_vertcoords[4*tailQuad], &_vertcoords[4*oldTailQuad], 4*tailQuads*sizeof(glm::i32vec2));
+		memmove(&_texcoords[4*tailQuad], &_texcoords[4*oldTailQuad], 4*tailQuads*sizeof(glm::u16vec2));
+		if (dy != 0) {
+			for (i = 4*tailQuad; i < 4*(tailQuad + tailQuads); ++i) {
+				_vertcoords[i].y += dy;
+			}
+		}
 
-		// Skip empty characters (in either dimension, this means we don't render spaces, for instance)
-		if (ci->sbw == 0) {
-			p = 0;
-			continue;
+		for (i = old; i < static_cast<int>(_oldLines.size()); ++i) {
+			next = _oldLines[i];
+			next.start += diff;
+			next.end += diff;
+			next.quad += tailQuad - oldTailQuad;
+			_lines.push_back(next);
 		}
+		_vertexCount = 4*(tailQuad + tailQuads);
+	}
+	else {
+		_vertexCount = 4*next.quad;
+	}
 
-		_vertexCount += 4;
-		_indexCount += 6;
-		p = c;
+	for (i = first; i <= line; ++i) {
+		drawLine(i);
 	}
+
+	_laidOut = _strLen;
+	_curX = alignLine(_lines.back()) + _lines.back().width;
+
+	// Kept lines that did not move do not need to be copied again
+	if (converged && tailQuad == oldTailQuad && dy == 0)
+		touch(firstQuad, tailQuad);
+	else
+		touch(firstQuad, std::max(oldQuads, _vertexCount/4));
 }
 
 /**
- * Append a string to this one
- * @param source The string to append
+ * Replaces part of the string, laying out only the new text and the character after it,
+ * whose kerning depends on what now precedes it. Every character after that keeps its
+ * layout, so its quads are moved and shifted by the change in pen position instead. The
+ * rest is only laid out again if it no longer fits within the bounds, or if it did not fit
+ * before the edit.
+ * @param start The byte offset to replace from, which must begin a UTF-8 sequence
+ * @param removed The number of bytes to remove
+ * @param inserted The text to insert in their place
  */
-void gui2d::String::append(const std::string& source) {
-	// First ensure we have capacity
-	if (!hasCapacity(_source.length() + source.length())) {
-		increaseCapacity(_source.length() + source.length(), _strLen);
+void gui2d::String::splice(int start, int removed, const std::string& inserted) {
+	int diff = static_cast<int>(inserted.length()) - removed;
+	int tail = start + removed;
+	int oldLaidOut, oldQuads, firstQuad, keep, oldKeepQuad, newKeepQuad, keptQuads, i;
+	GLint oldKeepPen, endPen, delta;
+	bool clipped, moveTail;
+	const char *c;
+
+	if (removed == 0 && inserted.empty())
+		return;
+
+	// Editing the text turns a numeric field back into ordinary text
+	if (_fieldSlots > 0) {
+		_fieldSlots = 0;
+		relayout();
 	}
 
-	// Now fill in the characters for our new string
-	findPenDraw(source);
+	oldLaidOut = _laidOut;
+	oldQuads = _vertexCount/4;
+	clipped = _laidOut < _strLen;
+	moveTail = tail < _laidOut;
 
-	// Save the string to our local copy
-	_source.append(source);
+	if (!hasCapacity(_strLen + diff)) {
+		increaseCapacity(_strLen + diff);
+	}
+
+	if (isWrapped()) {
+		spliceLines(start, removed, inserted);
+		return;
+	}
+
+	// Characters after one that did not fit are not drawn, so editing them changes nothing
+	if (start > _laidOut) {
+		_source.replace(start, removed, inserted);
+		_strLen = _source.length();
+		return;
+	}
+
+	firstQuad = _quadStarts[start];
+
+	if (moveTail) {
+		c = &_source.c_str()[tail];
+		Font::decodeUTF8(c);
+		keep = c - _source.c_str();
+
+		oldKeepPen = _pens[keep];
+		oldKeepQuad = _quadStarts[keep];
+		endPen = _pens[_laidOut];
+		keptQuads = oldQuads - oldKeepQuad;
+		newKeepQuad = firstQuad + countQuads(inserted) + (oldKeepQuad - _quadStarts[tail]);
+
+		// Move the kept layout into place before the new text is drawn over where it was
+		memmove(&_pens[keep + diff], &_pens[keep], (_laidOut - keep + 1)*sizeof(GLint));
+		memmove(&_quadStarts[keep + diff], &_quadStarts[keep], (_laidOut - keep + 1)*sizeof(uint16_t));
+		memmove(&_vertcoords[4*newKeepQuad], &_vertcoords[4*oldKeepQuad], 4*keptQuads*sizeof(glm::i32vec2));
+		memmove(&_texcoords[4*newKeepQuad], &_texcoords[4*oldKeepQuad], 4*keptQuads*sizeof(glm::u16vec2));
+	}
+
+	_source.replace(start, removed, inserted);
 	_strLen = _source.length();
+
+	if (!moveTail) {
+		layout(start, _strLen);
+		touch(firstQuad, std::max(oldQuads, _vertexCount/4));
+		return;
+	}
+
+	// Nothing after the new text is drawn if it does not fit
+	if (!layout(start, keep + diff)) {
+		touch(firstQuad, std::max(oldQuads, _vertexCount/4));
+		return;
+	}
+
+	delta = _pens[keep + diff] - oldKeepPen;
+	keep += diff;
+
+	// Pens only move forward, so the kept characters fit if the last one does
+	if (_startX + endPen + delta > _bMaxX) {
+		layout(keep, _strLen);
+		touch(firstQuad, std::max(oldQuads, _vertexCount/4));
+		return;
+	}
+
+	for (i = keep + 1; i <= oldLaidOut + diff; ++i) {
+		_pens[i] += delta;
+		_quadStarts[i] = static_cast<uint16_t>(_quadStarts[i] + newKeepQuad - oldKeepQuad);
+	}
+	for (i = 4*newKeepQuad; i < 4*(newKeepQuad + keptQuads); ++i) {
+		_vertcoords[i].x += delta;
+	}
+
+	_laidOut = oldLaidOut + diff;
+	_curX = endPen + delta;
+	_vertexCount = 4*(newKeepQuad + keptQuads);
+
+	// Characters that did not fit before may fit now
+	if (clipped)
+		layout(_laidOut, _strLen);
+
+	// Kept quads that did not move do not need to be copied again
+	if (delta == 0 && newKeepQuad == oldKeepQuad && !clipped)
+		touch(firstQuad, newKeepQuad);
+	else
+		touch(firstQuad, std::max(oldQuads, _vertexCount/4));
+}
+
+/**
+ * Append a string to this one
+ * @param source The string to append
+ */
+void gui2d::String::append(const std::string& source) {
+	splice(_strLen, 0, source);
 }
 
 /**
@@ -386,146 +860,334 @@ void gui2d::String::remove(int start) {
 /**
  * Remove part of a string, moving the characters after the substring down into
  * the newly vacated area
- * @param start The starting character index to remove from
- * @param length The number of characters to remove
+ * @param start The starting byte offset to remove from, which must begin a UTF-8 sequence
+ * @param length The number of bytes to remove
  */
 void gui2d::String::remove(int start, int length) {
-	std::string tail, front;
-
-	// Reset string info
-	_curX = _startX;
-	_curY = _startY;
-	_vertexCount = 0;
-	_indexCount = 0;
-
-	// If we're removing from the end, this is a lot faster
-	if (start+length >= _strLen) {
-		// Update the metrics
-		_source = _source.substr(0, start);
-		_strLen = start;
-		findPen(_source);
-	}
-	else {
-		// Get the two string bits that we're keeping
-		tail = _source.substr(start+length, std::string::npos);
-		front = _source.substr(0, start);
-
-		// Calculate the pen location based on the retained portion
-		findPen(front);
-
-		// Now, draw in the tail in the right place
-		findPenDraw(tail);
-		
-		// Update our source string and count information
-		_source = front.append(tail);
-		_strLen = _source.length();
-	}
+	splice(start, std::min(length, _strLen - start), std::string());
 }
 
 /**
  * Insert a string at a given offset
  * @param source The string to insert
- * @param offset The character offset to insert after
+ * @param offset The byte offset to insert at, which must begin a UTF-8 sequence
  */
 void gui2d::String::insert(const std::string& source, int offset) {
-	std::string front, tail;
+	splice(offset, 0, source);
+}
 
-	// Ensure we have capacity for both strings
-	if (!hasCapacity(_source.length() + source.length())) {
-		increaseCapacity(_source.length() + source.length(), offset);
+/**
+ * Draws fixed text followed by a numeric field of fixed width slots, which start out blank.
+ * Every slot is as wide as the widest digit, so that the text after a changing digit does
+ * not move. The string keeps its position.
+ * @param prefix The text before the field
+ * @param slots The number of characters that the field can show, at most MAX_FIELD_SLOTS
+ */
+void gui2d::String::drawField(const std::string& prefix, int slots) {
+	slots = std::max(0, std::min(slots, static_cast<int>(MAX_FIELD_SLOTS)));
+
+	if (!hasCapacity(prefix.length() + slots)) {
+		_vertexCount = _laidOut = 0;
+		increaseCapacity(prefix.length() + slots + 1);
 	}
 
-	// Set up all of our strings
-	front = _source.substr(0, offset);
-	tail = _source.substr(offset, std::string::npos);
+	// Reserve room for the field's characters, so that setting it never allocates
+	_source = prefix;
+	_source.reserve(prefix.length() + slots);
+	_strLen = _source.length();
 
-	// Zero counters for new draw
-	_curX = _startX;
-	_curY = _startY;
-	_vertexCount = 0;
-	_indexCount = 0;
+	_fieldPrefix = _strLen;
+	_fieldSlots = slots;
+	relayout();
+}
 
-	// Update/draw each string component
-	findPen(front);
-	findPenDraw(source);
-	findPenDraw(tail);
+/**
+ * Lays out the text before the numeric field and draws every slot that fits within the
+ * bounds. The pen is left at the end of the full field, so that moving the string lays it
+ * out again if any slot is clipped.
+ */
+void gui2d::String::layoutField(void) {
+	const char *c;
+	int fit = 0;
+	int i;
 
-	// Save new metrics
-	_source = front.append(source).append(tail);
-	_strLen = _source.length();
+	_fieldAdvance = 0;
+	for (c = "0123456789-.#"; *c != 0; ++c) {
+		_fieldAdvance = std::max(_fieldAdvance, static_cast<GLint>(_font->getCharInfo(*c)->ax));
+	}
+
+	if (layout(0, _fieldPrefix)) {
+		while (fit < _fieldSlots && _startX + _curX + (fit + 1)*_fieldAdvance <= _bMaxX) {
+			fit += 1;
+		}
+	}
+
+	_fieldQuad = _vertexCount/4;
+	_fieldPen = _curX;
+
+	for (i = 0; i < fit; ++i) {
+		drawSlot(i, _fieldPrefix + i < _strLen ? _source[_fieldPrefix + i] : 0);
+	}
+
+	_vertexCount = 4*(_fieldQuad + fit);
+	_curX = _fieldPen + _fieldSlots*_fieldAdvance;
+	if (_laidOut == _fieldPrefix)
+		_laidOut = _strLen;
 }
 
 /**
- * Initialize the graphics the first time that this is rendered
+ * Draws one character of the numeric field centered in its slot
+ * @param slot The slot to draw, which must fit within the bounds
+ * @param c The character to draw, or zero to leave the slot blank
  */
-void gui2d::String::graphicsInit(void) {
-	gui2d::Manager& m = gui2d::Manager::getSingleton();
+void gui2d::String::drawSlot(int slot, char c) {
+	const gui2d::Font::char_info *ci;
+	int vertex = 4*(_fieldQuad + slot);
+	GLint pen;
+
+	std::fill(&_vertcoords[vertex], &_vertcoords[vertex + 4], glm::i32vec2(0));
+	std::fill(&_texcoords[vertex], &_texcoords[vertex + 4], glm::u16vec2(0));
+	if (c == 0)
+		return;
+
+	ci = _font->getCharInfo(static_cast<unsigned char>(c));
+	pen = _fieldPen + slot*_fieldAdvance + (_fieldAdvance - ci->ax)/2;
+	drawChar(*ci, pen, 0, vertex);
+}
 
-	// If already initialized, delete these buffers
-	if (_gInit) {
-		glBindVertexArray(0);
-		glDeleteVertexArrays(1, &_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glDeleteBuffers(2, _vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glDeleteBuffers(1, &_ibo);
+/**
+ * Writes the decimal digits of a number, as std::to_chars would
+ * @param value The number to write
+ * @param text Buffer to write to, which must hold at least 20 characters
+ * @return The number of characters written
+ */
+int gui2d::String::formatInteger(unsigned long value, char *text) {
+	char digits[20];
+	int count = 0;
+	int i;
+
+	do {
+		digits[count++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	for (i = 0; i < count; ++i) {
+		text[i] = digits[count - 1 - i];
 	}
+	return count;
+}
 
-	// Generate a vertex array object for our buffers
-	glGenVertexArrays(1, &_vao);
-	glBindVertexArray(_vao);
-	
-	// Generate the vertex buffer that will store our vertices and texture coordinates
-	glGenBuffers(2, _vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
-	glVertexAttribPointer(m.getTSInVertLocation(), 2, GL_SHORT, GL_TRUE, sizeof(glm::i16vec2), 0);
-	glEnableVertexAttribArray(m.getTSInVertLocation());
-	
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo[1]);
-	glVertexAttribPointer(m.getTSInTexLocation(), 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(glm::u16vec2), 0);
-	glEnableVertexAttribArray(m.getTSInTexLocation());
+/**
+ * Shows an integer in the numeric field
+ * @param value The number to show
+ */
+void gui2d::String::setField(long value) {
+	char text[MAX_FIELD_SLOTS];
+	int length = 0;
+	unsigned long magnitude = static_cast<unsigned long>(value);
+
+	if (value < 0) {
+		text[length++] = '-';
+		magnitude = 0UL - magnitude;
+	}
 
-	// Generate the index buffer object
-	glGenBuffers(1, &_ibo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+	length += formatInteger(magnitude, &text[length]);
+	setFieldText(text, length);
+}
 
-	glBindVertexArray(0);
+/**
+ * Shows a number in the numeric field with a fixed number of decimal places
+ * @param value The number to show
+ * @param decimals Digits to show after the decimal point, up to six
+ */
+void gui2d::String::setField(double value, int decimals) {
+	char text[MAX_FIELD_SLOTS];
+	int length = 0;
+	unsigned long scale = 1;
+	unsigned long rounded;
+	unsigned long fraction;
+	double magnitude = value < 0 ? -value : value;
+	int i;
+
+	decimals = std::max(0, std::min(decimals, 6));
+	for (i = 0; i < decimals; ++i) {
+		scale *= 10;
+	}
 
-	_gInit = true;
+	// Numbers too large for the digits to be exact would not fit in any field anyway
+	if (!(magnitude*scale < 1e18)) {
+		setFieldText(text, MAX_FIELD_SLOTS + 1);
+		return;
+	}
+
+	rounded = static_cast<unsigned long>(magnitude*scale + 0.5);
+	if (value < 0 && rounded > 0)
+		text[length++] = '-';
+
+	length += formatInteger(rounded/scale, &text[length]);
+
+	if (decimals > 0) {
+		text[length++] = '.';
+		fraction = rounded % scale;
+		for (i = decimals - 1; i >= 0; --i) {
+			text[length + i] = static_cast<char>('0' + fraction % 10);
+			fraction /= 10;
+		}
+		length += decimals;
+	}
+
+	setFieldText(text, length);
 }
 
 /**
- * Render function. For now this is kind of dumb and will regenerate+rebind VBOs on each render call.
+ * Changes the characters of the numeric field, redrawing only the slots that changed. Text
+ * that is longer than the field is shown as a row of '#' instead.
+ * @param text The new characters
+ * @param length The number of characters
  */
-void gui2d::String::render(void) {
-	// Generate buffers one time if they haven't been
-	if (!_gInit)
-		graphicsInit();
+void gui2d::String::setFieldText(const char *text, int length) {
+	char overflow[MAX_FIELD_SLOTS];
+	int shown, i;
+	char c, old;
 
-	// Don't draw anything if this string isn't visible
-	if (!_visible)
+	if (_fieldSlots == 0)
 		return;
 
-	// Update the buffer data if we've been modified
-	glBindVertexArray(_vao);
-	if (_modified) {
-		glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
-		glBufferData(GL_ARRAY_BUFFER, _vertexCount*sizeof(glm::i16vec2), _vertcoords, GL_DYNAMIC_DRAW);
+	if (length > _fieldSlots) {
+		std::fill(overflow, overflow + _fieldSlots, '#');
+		text = overflow;
+		length = _fieldSlots;
+	}
 
-		glBindBuffer(GL_ARRAY_BUFFER, _vbo[1]);
-		glBufferData(GL_ARRAY_BUFFER, _vertexCount*sizeof(glm::u16vec2), _texcoords, GL_DYNAMIC_DRAW);
+	refresh();
+	shown = _vertexCount/4 - _fieldQuad;
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indexCount*sizeof(GLushort), _index, GL_DYNAMIC_DRAW);
+	for (i = 0; i < shown; ++i) {
+		c = i < length ? text[i] : 0;
+		old = _fieldPrefix + i < _strLen ? _source[_fieldPrefix + i] : 0;
+		if (c != old) {
+			drawSlot(i, c);
+			touch(_fieldQuad + i, _fieldQuad + i + 1);
+		}
 	}
 
-	// Apply the user's chosen color and Z-ordering
-	gui2d::Manager& m = gui2d::Manager::getSingleton();
-	glUniform4fv(m.getTSUniformColorLocation(), 1, glm::value_ptr(_color));
-	glUniform1f(m.getTSUniformZLocation(), _z);
-	
-	// Render using the index buffer
-	glDrawElements(GL_TRIANGLES, _indexCount, GL_UNSIGNED_SHORT, 0);
-	glBindVertexArray(0);
-	_modified = false;
+	// The field is laid out in full whenever the text before it fits
+	if (_laidOut == _strLen)
+		_laidOut = _fieldPrefix + length;
+
+	_source.replace(_fieldPrefix, std::string::npos, text, length);
+	_strLen = _source.length();
+}
+
+/**
+ * Records that a range of quads was changed by an edit, so that render() only copies them
+ * @param first The first quad that changed
+ * @param end One past the last quad that changed
+ */
+void gui2d::String::touch(int first, int end) {
+	if (_dirtyFirst >= _dirtyEnd) {
+		_dirtyFirst = first;
+		_dirtyEnd = end;
+	}
+	else {
+		_dirtyFirst = std::min(_dirtyFirst, first);
+		_dirtyEnd = std::max(_dirtyEnd, end);
+	}
+}
+
+/**
+ * Update the z index, which is copied into every vertex
+ * @param z The new z to use, this is an unnormalized short
+ */
+void gui2d::String::setZ(GLushort z) {
+	_setZ(z);
+	_modified = true;
+}
+
+/**
+ * Lays the string out again if the font has evicted glyphs since it was last laid out in
+ * full, because the texture coordinates it holds may now point at other glyphs
+ */
+void gui2d::String::refresh(void) {
+	if (_glyphGeneration != _font->getGeneration())
+		relayout();
+}
+
+/**
+ * Computes where a vertex of the laid out glyphs falls on screen. The start is added in 32
+ * bits, and the sum is clamped to the normalized range, so that a glyph far off screen is
+ * flattened against its edge rather than wrapping around to the other side.
+ * @param vertex Index of the vertex, below getVertexCount()
+ * @return Screen position of the vertex, normalized
+ */
+glm::i16vec2 gui2d::String::getPosition(int vertex) const {
+	GLint x = _vertcoords[vertex].x + _startX;
+	GLint y = _vertcoords[vertex].y + _startY;
+
+	return glm::i16vec2(static_cast<GLshort>(glm::clamp(x, static_cast<GLint>(SHRT_MIN), static_cast<GLint>(SHRT_MAX))),
+						static_cast<GLshort>(glm::clamp(y, static_cast<GLint>(SHRT_MIN), static_cast<GLint>(SHRT_MAX))));
+}
+
+/**
+ * Copies the glyph quads into a text batch if they have changed. Reserved quads beyond the
+ * drawn glyphs are zeroed so that they are not rasterized. After an edit, only the quads
+ * that it changed are copied, and after a move, only the positions of the drawn quads.
+ * @param vCoords Vertex coordinate array to write to, starting at this string's quads
+ * @param attribs Attribute array to write to, starting at this string's quads
+ * @param offset The quad offset of this string within the batch
+ * @param force Copy all of the data even if it has not changed
+ * @param first Set to the first quad that was copied, relative to this string
+ * @param count Set to the number of quads that were copied
+ * @param positionsOnly Set if only the vertex coordinates were copied, and not the attributes
+ * @return True if any data was copied
+ */
+bool gui2d::String::render(glm::i16vec3 *vCoords, gui2d::GlyphAttrib *attribs, uint32_t offset, bool force, uint32_t& first, uint32_t& count,
+							bool& positionsOnly) {
+	uint8_t sr, sg, sb, sa;
+	glm::u8vec4 color;
+	int i, start, end;
+
+	refresh();
+	positionsOnly = false;
+
+	if (_modified || force) {
+		start = 0;
+		end = _maxCount;
+	}
+	else if (_moved) {
+		// An edit since the move may also have changed or cleared some quads
+		start = 0;
+		end = std::max(_vertexCount/4, _dirtyEnd);
+		positionsOnly = _dirtyFirst >= _dirtyEnd;
+	}
+	else if (_dirtyFirst < _dirtyEnd) {
+		start = _dirtyFirst;
+		end = _dirtyEnd;
+	}
+	else {
+		return false;
+	}
+
+	sr = static_cast<uint8_t>(glm::clamp(_color.r, 0.0f, 1.0f)*255);
+	sg = static_cast<uint8_t>(glm::clamp(_color.g, 0.0f, 1.0f)*255);
+	sb = static_cast<uint8_t>(glm::clamp(_color.b, 0.0f, 1.0f)*255);
+	sa = static_cast<uint8_t>(glm::clamp(_color.a, 0.0f, 1.0f)*255);
+	color = glm::u8vec4(sr, sg, sb, sa);
+
+	for (i = 4*start; i < std::min(4*end, _vertexCount); ++i) {
+		vCoords[i] = glm::i16vec3(getPosition(i), _z);
+		if (!positionsOnly) {
+			attribs[i].tex = _texcoords[i];
+			attribs[i].color = color;
+		}
+	}
+
+	if (4*end > _vertexCount)
+		std::fill(&vCoords[std::max(4*start, _vertexCount)], &vCoords[4*end], glm::i16vec3(0));
+
+	first = start;
+	count = end - start;
+	_dirtyFirst = _dirtyEnd = 0;
+	_modified = _moved = false;
+	return true;
 }
@@ -0,0 +1,252 @@
+/**
+ * @file 2dgui/TextRenderer.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstddef>
+
+// Project definitions
+#include "Shader.h"
+#include "2dgui/gui2d.h"
+#include "2dgui/QuadRendererBase.h"
+#include "2dgui/TextRenderer.h"
+#include "2dgui/GlyphAtlas.h"
+#include "2dgui/String.h"
+
+/**
+ * Assign vertex attribute pointers and create the VBO for glyph attributes
+ * @param s The shader program to use for text
+ * @param glyphAtlas The atlas shared by every font
+ * @param strings The manager's lists of strings for each font
+ */
+gui2d::TextRenderer::TextRenderer(Shader *s, gui2d::GlyphAtlas *glyphAtlas, gui2d::FontStringList *strings) : QuadRendererBase<gui2d::TextRenderer, gui2d::String>(s),
+		_glyphAtlas(glyphAtlas), _strings(strings), _attribs(0), _attribVBO(0), _attribAll(false),
+		_outlineWidth(0.0f), _outlineColor(0.0f), _shadowOffset(0.0f), _shadowColor(0.0f) {
+	_s_tex = s->getAttribLocation("in_tex");
+	_s_color = s->getAttribLocation("in_color");
+	_gs_tex = s->getUniformLocation("tex");
+	_gs_outlineWidth = s->getUniformLocation("un_outlineWidth");
+	_gs_outlineColor = s->getUniformLocation("un_outlineColor");
+	_gs_shadowOffset = s->getUniformLocation("un_shadowOffset");
+	_gs_shadowColor = s->getUniformLocation("un_shadowColor");
+
+	// Create buffers
+	glGenBuffers(1, &_attribVBO);
+	bindBufferAttributes();
+}
+
+/**
+ * Deallocate our buffers and release opengl resources
+ */
+gui2d::TextRenderer::~TextRenderer(void) {
+	glDeleteBuffers(1, &_attribVBO);
+
+	if (_bufferSize) {
+		free(_attribs);
+	}
+}
+
+/**
+ * Ensure that the attribute array is large enough to handle a given number of quads
+ * @param quads The number of quads we need to be able to store
+ */
+void gui2d::TextRenderer::resizeBuffers(uint32_t quads) {
+	_attribs = static_cast<gui2d::GlyphAttrib *>(realloc(_attribs, quads*getAttribSize()));
+}
+
+/**
+ * Points the vertex, texture coordinate, and color attributes at the given buffers
+ * @param vertexBuffer The buffer holding vertex coordinates, starting at offset zero
+ * @param attribBuffer The buffer holding the interleaved glyph attributes
+ * @param attribOffset Byte offset of the first glyph attribute within attribBuffer
+ */
+void gui2d::TextRenderer::bindAttributes(GLuint vertexBuffer, GLuint attribBuffer, GLintptr attribOffset) {
+	glBindVertexArray(_vao);
+	bindVertexAttributes(vertexBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, attribBuffer);
+	glVertexAttribPointer(_s_tex, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(gui2d::GlyphAttrib),
+							reinterpret_cast<GLvoid *>(attribOffset + offsetof(gui2d::GlyphAttrib, tex)));
+	glEnableVertexAttribArray(_s_tex);
+	glVertexAttribPointer(_s_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(gui2d::GlyphAttrib),
+							reinterpret_cast<GLvoid *>(attribOffset + offsetof(gui2d::GlyphAttrib, color)));
+	glEnableVertexAttribArray(_s_color);
+
+	glBindVertexArray(0);
+}
+
+/**
+ * Points the vertex attributes at our ordinary (non-streaming) vertex buffer objects
+ */
+void gui2d::TextRenderer::bindBufferAttributes(void) {
+	bindAttributes(_vbo[0], _attribVBO, 0);
+}
+
+/**
+ * Passes the render call forward to one string pointed to by an iterator, and marks the
+ * quads that it copied, which after an edit are only the ones that changed. The attributes
+ * are marked separately, unless the string only moved.
+ * @param iter The iterator pointing to the string to pass render() to
+ * @param offset The array offset to use
+ * @param force Should the string copy its data even if it has not changed
+ * @return Always false, since the string's own range has already been marked
+ */
+bool gui2d::TextRenderer::renderItem(RenderableIter& iter, uint32_t offset, bool force) {
+	uint32_t first, count;
+	bool positionsOnly;
+	DirtyRange range;
+
+	if (!iter->second->render(&_vCoords[4*offset], &_attribs[4*offset], offset, force, first, count, positionsOnly))
+		return false;
+
+	markDirty(offset + first, count);
+	if (!positionsOnly) {
+		range.first = offset + first;
+		range.count = count;
+		_attribDirty.push_back(range);
+	}
+	return false;
+}
+
+/**
+ * Writes one string directly into a region of the streaming buffer
+ * @param iter The iterator pointing to the string to pass render() to
+ * @param vCoords Start of the vertex coordinates for the current region
+ * @param attribs Start of the glyph attributes for the current region
+ * @param offset The quad offset to use within the region
+ */
+void gui2d::TextRenderer::streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset) {
+	gui2d::GlyphAttrib *gAttribs = reinterpret_cast<gui2d::GlyphAttrib *>(attribs);
+	uint32_t first, count;
+	bool positionsOnly;
+
+	iter->second->render(&vCoords[4*offset], &gAttribs[4*offset], offset, true, first, count, positionsOnly);
+}
+
+/**
+ * Re-specifies the attribute vbo on the gpu so that it can hold a given number of quads
+ * @param quads The number of quads the vbo must be able to hold
+ */
+void gui2d::TextRenderer::reserveBuffers(uint32_t quads) {
+	glBindBuffer(GL_ARRAY_BUFFER, _attribVBO);
+	glBufferData(GL_ARRAY_BUFFER, quads*getAttribSize(), 0, GL_DYNAMIC_DRAW);
+	_attribAll = true;
+}
+
+/**
+ * Pushes the glyph attributes within a range of modified quads to the gpu, skipping those
+ * of strings that only moved
+ * @param first The first quad to upload
+ * @param quads The number of quads to upload
+ * @return The number of bytes uploaded
+ */
+size_t gui2d::TextRenderer::updateBuffers(uint32_t first, uint32_t quads) {
+	std::vector<DirtyRange>::iterator iter;
+	uint32_t start, end;
+	size_t bytes = 0;
+
+	glBindBuffer(GL_ARRAY_BUFFER, _attribVBO);
+
+	if (_attribAll) {
+		glBufferSubData(GL_ARRAY_BUFFER, first*getAttribSize(), quads*getAttribSize(), &_attribs[4*first]);
+		return quads*getAttribSize();
+	}
+
+	for (iter = _attribDirty.begin(); iter != _attribDirty.end(); ++iter) {
+		start = std::max(first, iter->first);
+		end = std::min(first + quads, iter->first + iter->count);
+		if (start >= end)
+			continue;
+
+		glBufferSubData(GL_ARRAY_BUFFER, start*getAttribSize(), (end - start)*getAttribSize(), &_attribs[4*start]);
+		bytes += (end - start)*getAttribSize();
+	}
+	return bytes;
+}
+
+/**
+ * Gives a slot to every visible string that does not have one, and takes it away from
+ * hidden strings. Strings whose capacity has changed are moved to a slot of the new size.
+ * Strings in fonts that use another atlas are left to another renderer.
+ */
+void gui2d::TextRenderer::updateSlots(void) {
+	FontStringListIter font;
+	StringListIter iter;
+	SlotIter slot;
+	String *s;
+
+	for (font = _strings->begin(); font != _strings->end(); ++font) {
+		for (iter = font->second->begin(); iter != font->second->end(); ++iter) {
+			s = *iter;
+			if (s->getFont()->getAtlas() != _glyphAtlas)
+				continue;
+
+			slot = _slots.find(s);
+
+			if (slot != _slots.end()) {
+				if (s->isVisible() && slot->second.quads == s->getQuadCount())
+					continue;
+				hide(s);
+			}
+
+			if (s->isVisible())
+				show(s);
+		}
+	}
+}
+
+/**
+ * Uploads any glyphs that the strings rasterized while copying themselves, then binds the
+ * glyph atlas and draws every string with a single call
+ */
+void gui2d::TextRenderer::drawElements(void) {
+	glActiveTexture(GL_TEXTURE0);
+	_glyphAtlas->flush();
+	glUniform1i(_gs_tex, 0);
+	glBindTexture(GL_TEXTURE_2D, _glyphAtlas->getTexture());
+
+	glUniform1f(_gs_outlineWidth, _outlineWidth);
+	glUniform4fv(_gs_outlineColor, 1, glm::value_ptr(_outlineColor));
+	glUniform2fv(_gs_shadowOffset, 1, glm::value_ptr(_shadowOffset));
+	glUniform4fv(_gs_shadowColor, 1, glm::value_ptr(_shadowColor));
+
+	glDrawElementsBaseVertex(GL_TRIANGLES, 6*_count, _indexType, 0, _baseVertex);
+	_drawCalls += 1;
+}
+
+/**
+ * Brings the slots up to date with the strings' visibility and size, then draws
+ */
+void gui2d::TextRenderer::render(void) {
+	updateSlots();
+	QuadRendererBase<gui2d::TextRenderer, gui2d::String>::render();
+
+	_attribDirty.clear();
+	_attribAll = false;
+}
+
+/**
+ * Sets the outline drawn around every distance field glyph
+ * @param width Width of the outline as a fraction of the distance field's spread, or zero for none
+ * @param color Color of the outline
+ */
+void gui2d::TextRenderer::setOutline(float width, const glm::vec4& color) {
+	_outlineWidth = width;
+	_outlineColor = color;
+}
+
+/**
+ * Sets the drop shadow drawn behind every distance field glyph
+ * @param offset Offset of the shadow in pixels of the distance field, which should not exceed its spread
+ * @param color Color of the shadow, with an alpha of zero for none
+ */
+void gui2d::TextRenderer::setShadow(const glm::vec2& offset, const glm::vec4& color) {
+	_shadowOffset = offset;
+	_shadowColor = color;
+}
@@ -0,0 +1,373 @@
+/**
+ * @file 2dgui/TextureAtlas.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/TextureAtlas.h"
+
+const float gui2d::TextureAtlas::DEFRAG_THRESHOLD = 0.5f;
+
+namespace {
+
+/**
+ * Orders atlas entries from tallest to shortest, which packs a skyline more tightly
+ */
+struct TallerEntry {
+	const std::vector<gui2d::TextureAtlas::Entry>& entries;
+
+	TallerEntry(const std::vector<gui2d::TextureAtlas::Entry>& e) : entries(e) {}
+
+	bool operator()(uint32_t a, uint32_t b) const {
+		return entries[a].h > entries[b].h;
+	}
+};
+
+};
+
+/**
+ * The atlas starts without any pages, they are created as images are added
+ */
+gui2d::TextureAtlas::TextureAtlas(void) : _texture(0), _layers(0), _generation(0), _sinceDefrag(0), _fragmented(false) {
+	glGenTextures(1, &_texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/**
+ * Deletes the array texture and the CPU copies of all images
+ */
+gui2d::TextureAtlas::~TextureAtlas(void) {
+	std::vector<Entry>::iterator entry;
+
+	glDeleteTextures(1, &_texture);
+
+	for (entry = _entries.begin(); entry != _entries.end(); ++entry) {
+		free(entry->pixels);
+	}
+}
+
+/**
+ * Grows the array texture so that it has at least a given number of layers. Re-specifying
+ * the texture discards its contents, so every placed image is uploaded again from its CPU copy.
+ * @param layers The number of layers needed
+ */
+void gui2d::TextureAtlas::reserveLayers(int layers) {
+	std::vector<Entry>::iterator entry;
+
+	if (layers <= _layers)
+		return;
+
+	_layers = std::max(layers, 2*_layers);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, PAGE_SIZE, PAGE_SIZE, _layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+	for (entry = _entries.begin(); entry != _entries.end(); ++entry) {
+		if (entry->page >= 0)
+			upload(*entry);
+	}
+}
+
+/**
+ * Creates a new, empty page, growing the array texture if it has no spare layer
+ * @return The index of the new page
+ */
+int gui2d::TextureAtlas::createPage(void) {
+	Page page;
+	SkylineNode node;
+
+	reserveLayers(_pages.size() + 1);
+
+	node.x = 0;
+	node.y = 0;
+	node.width = PAGE_SIZE;
+	page.skyline.push_back(node);
+	page.packedArea = 0;
+	page.liveArea = 0;
+
+	_pages.push_back(page);
+	return _pages.size() - 1;
+}
+
+/**
+ * Checks whether a rectangle can be placed with its left edge at the start of a skyline node
+ * @param page The page to check
+ * @param node The skyline node to align the rectangle with
+ * @param w The width of the rectangle
+ * @param h The height of the rectangle
+ * @param[out] y The lowest position at which the rectangle rests on the skyline
+ * @return True if the rectangle fits within the page at that position
+ */
+bool gui2d::TextureAtlas::fitsAt(const Page& page, size_t node, int w, int h, int& y) const {
+	int widthLeft = w;
+
+	if (page.skyline[node].x + w > PAGE_SIZE)
+		return false;
+
+	y = 0;
+	while (widthLeft > 0) {
+		y = std::max(y, page.skyline[node].y);
+		if (y + h > PAGE_SIZE)
+			return false;
+		widthLeft -= page.skyline[node].width;
+		node += 1;
+	}
+
+	return true;
+}
+
+/**
+ * Finds the lowest, then leftmost, position for a rectangle on a page and raises the
+ * skyline over it
+ * @param page The page to pack into
+ * @param w The width of the rectangle
+ * @param h The height of the rectangle
+ * @param[out] x The left edge of the placed rectangle
+ * @param[out] y The bottom edge of the placed rectangle
+ * @return True if the rectangle was placed, false if the page is too full
+ */
+bool gui2d::TextureAtlas::pack(Page& page, int w, int h, int& x, int& y) {
+	std::vector<SkylineNode>& skyline = page.skyline;
+	size_t i, best = skyline.size();
+	int bestY = PAGE_SIZE;
+	int nodeY, shrink;
+	SkylineNode node;
+
+	for (i = 0; i < skyline.size(); ++i) {
+		if (fitsAt(page, i, w, h, nodeY) && nodeY < bestY) {
+			best = i;
+			bestY = nodeY;
+		}
+	}
+
+	if (best == skyline.size())
+		return false;
+
+	x = skyline[best].x;
+	y = bestY;
+
+	// Raise the skyline over the new rectangle
+	node.x = x;
+	node.y = y + h;
+	node.width = w;
+	skyline.insert(skyline.begin() + best, node);
+
+	// Trim the nodes that are now covered by it
+	i = best + 1;
+	while (i < skyline.size()) {
+		shrink = skyline[i-1].x + skyline[i-1].width - skyline[i].x;
+		if (shrink <= 0)
+			break;
+
+		skyline[i].x += shrink;
+		skyline[i].width -= shrink;
+		if (skyline[i].width > 0)
+			break;
+
+		skyline.erase(skyline.begin() + i);
+	}
+
+	// Merge neighbors at the same height
+	for (i = 0; i + 1 < skyline.size(); ) {
+		if (skyline[i].y == skyline[i+1].y) {
+			skyline[i].width += skyline[i+1].width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else {
+			i += 1;
+		}
+	}
+
+	page.packedArea += w*h;
+	page.liveArea += w*h;
+	return true;
+}
+
+/**
+ * Places an image in the first existing page that has room for it, and computes its
+ * texture coordinates there
+ * @param entry The image to place, with its size filled in
+ * @return True if the image was placed, false if no page has room
+ */
+bool gui2d::TextureAtlas::place(Entry& entry) {
+	size_t i;
+
+	for (i = 0; i < _pages.size(); ++i) {
+		if (pack(_pages[i], entry.w, entry.h, entry.x, entry.y)) {
+			entry.page = i;
+			entry.uv.x = static_cast<GLushort>((entry.x + PADDING)*USHRT_MAX/PAGE_SIZE);
+			entry.uv.y = static_cast<GLushort>((entry.y + PADDING)*USHRT_MAX/PAGE_SIZE);
+			entry.uv.z = static_cast<GLushort>((entry.x + entry.w - PADDING)*USHRT_MAX/PAGE_SIZE);
+			entry.uv.w = static_cast<GLushort>((entry.y + entry.h - PADDING)*USHRT_MAX/PAGE_SIZE);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Copies an image from its CPU copy into its place on its page
+ * @param entry The placed image to upload
+ */
+void gui2d::TextureAtlas::upload(const Entry& entry) {
+	glBindTexture(GL_TEXTURE_2D_ARRAY, _texture);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, entry.x, entry.y, entry.page, entry.w, entry.h, 1,
+					GL_RGBA, GL_UNSIGNED_BYTE, entry.pixels);
+}
+
+/**
+ * Adds an image to the atlas. The edges of the image are replicated into a one pixel border
+ * so that linear filtering never samples a neighboring image.
+ * @param rgba Tightly packed RGBA pixel data
+ * @param w Width of the image, in pixels
+ * @param h Height of the image, in pixels
+ * @return Handle for the image, or 0 if the image is too large for the atlas
+ */
+GLuint gui2d::TextureAtlas::add(const GLubyte *rgba, int w, int h) {
+	Entry entry;
+	uint32_t index;
+	int row, col, sx, sy;
+
+	if (!fits(w, h))
+		return 0;
+
+	entry.w = w + 2*PADDING;
+	entry.h = h + 2*PADDING;
+	entry.pixels = static_cast<GLubyte *>(malloc(entry.w*entry.h*4));
+
+	for (row = 0; row < entry.h; ++row) {
+		sy = glm::clamp(row - PADDING, 0, h - 1);
+		for (col = 0; col < entry.w; ++col) {
+			sx = glm::clamp(col - PADDING, 0, w - 1);
+			std::memcpy(&entry.pixels[4*(row*entry.w + col)], &rgba[4*(sy*w + sx)], 4);
+		}
+	}
+
+	// Reclaim dead space before growing the atlas by another page
+	if (!place(entry)) {
+		if (_fragmented)
+			defragment();
+		if (!place(entry)) {
+			createPage();
+			place(entry);
+		}
+	}
+	upload(entry);
+
+	if (_freeEntries.empty()) {
+		index = _entries.size();
+		_entries.push_back(entry);
+	}
+	else {
+		index = _freeEntries.back();
+		_freeEntries.pop_back();
+		_entries[index] = entry;
+	}
+
+	return HANDLE_BIT | index;
+}
+
+/**
+ * Removes an image from the atlas. Its space is not reused until the atlas is defragmented.
+ * @param handle The handle returned by add()
+ */
+void gui2d::TextureAtlas::remove(GLuint handle) {
+	uint32_t index = handle & ~HANDLE_BIT;
+	Entry& entry = _entries[index];
+	Page& page = _pages[entry.page];
+
+	page.liveArea -= entry.w*entry.h;
+	if (page.liveArea < page.packedArea*(1.0f - DEFRAG_THRESHOLD) &&
+		page.packedArea - page.liveArea >= DEFRAG_MIN_AREA)
+		_fragmented = true;
+
+	free(entry.pixels);
+	entry.pixels = 0;
+	entry.page = -1;
+	_freeEntries.push_back(index);
+}
+
+/**
+ * Repacks every live image into as few pages as possible, tallest first, and deletes pages
+ * that are left empty. Every image may move, so the generation is incremented.
+ */
+void gui2d::TextureAtlas::defragment(void) {
+	std::vector<uint32_t> order;
+	std::vector<uint32_t>::iterator iter;
+	std::vector<Page>::iterator page;
+	SkylineNode node;
+	uint32_t i;
+
+	for (i = 0; i < _entries.size(); ++i) {
+		if (_entries[i].page >= 0)
+			order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(), TallerEntry(_entries));
+
+	node.x = 0;
+	node.y = 0;
+	node.width = PAGE_SIZE;
+	for (page = _pages.begin(); page != _pages.end(); ++page) {
+		page->skyline.clear();
+		page->skyline.push_back(node);
+		page->packedArea = 0;
+		page->liveArea = 0;
+	}
+
+	for (iter = order.begin(); iter != order.end(); ++iter) {
+		if (!place(_entries[*iter])) {
+			createPage();
+			place(_entries[*iter]);
+		}
+	}
+
+	// Upload only once everything is placed, since unplaced images still overlap placed ones
+	for (iter = order.begin(); iter != order.end(); ++iter) {
+		upload(_entries[*iter]);
+	}
+
+	// Pages are filled in order, so any that are empty are at the end. Their layers are kept.
+	while (!_pages.empty() && _pages.back().liveArea == 0) {
+		_pages.pop_back();
+	}
+
+	_generation += 1;
+	_sinceDefrag = 0;
+	_fragmented = false;
+}
+
+/**
+ * Per-frame maintenance, which defragments the atlas if enough space has been freed and
+ * the last defragmentation was long enough ago. Images added in the meantime may still
+ * trigger one early rather than growing the atlas by another page.
+ */
+void gui2d::TextureAtlas::update(void) {
+	if (_sinceDefrag < DEFRAG_COOLDOWN)
+		_sinceDefrag += 1;
+
+	if (_fragmented && _sinceDefrag >= DEFRAG_COOLDOWN)
+		defragment();
+}
+
+/**
+ * Retrieve the placement of an image
+ * @param handle The handle returned by add()
+ * @return The entry describing the image's page and texture coordinates
+ */
+const gui2d::TextureAtlas::Entry& gui2d::TextureAtlas::getEntry(GLuint handle) const {
+	return _entries[handle & ~HANDLE_BIT];
+}
@@ -7,6 +7,7 @@
 #include <gl/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_precision.hpp>
+#include <algorithm>
 
 // Project definitions
 #include "Shader.h"
@@ -14,29 +15,22 @@
 #include "2dgui/QuadRendererBase.h"
 #include "2dgui/iTexturedQuadRenderable.h"
 #include "2dgui/TexturedQuadRenderer.h"
+#include "2dgui/TextureAtlas.h"
 
 /**
  * Assign vertex attribute pointers and create VBO for storing texture coordinates
  * @param s The shader program to use for textured quads
  */
-gui2d::TexturedQuadRenderer::TexturedQuadRenderer(Shader *s) : QuadRendererBase<gui2d::TexturedQuadRenderer, gui2d::iTexturedQuadRenderable>(s), _tCoords(0), _textureVBO(0) {
-	int s_vert = s->getAttribLocation("in_vert");
-	int s_tex = s->getAttribLocation("in_tex");
+gui2d::TexturedQuadRenderer::TexturedQuadRenderer(Shader *s) : QuadRendererBase<gui2d::TexturedQuadRenderer, gui2d::iTexturedQuadRenderable>(s), _batchBufferSize(0), _tCoords(0), _textureVBO(0) {
+	_s_tex = s->getAttribLocation("in_tex");
+	_s_texMax = s->getAttribLocation("in_tex_max");
 	_gs_tex = s->getUniformLocation("tex");
+	_gs_texArray = s->getUniformLocation("texArray");
+	_gs_layered = s->getUniformLocation("un_layered");
 
 	// Create buffers
-	glBindVertexArray(_vao);
 	glGenBuffers(1, &_textureVBO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
-	glVertexAttribPointer(s_vert, 3, GL_SHORT, GL_TRUE, sizeof(glm::i16vec3), 0);
-	glEnableVertexAttribArray(s_vert);
-
-	glBindBuffer(GL_ARRAY_BUFFER, _textureVBO);
-	glVertexAttribPointer(s_tex, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(glm::u16vec3), 0);
-	glEnableVertexAttribArray(s_tex);
-
-	glBindVertexArray(0);
+	bindBufferAttributes();
 }
 
 /**
@@ -56,52 +50,188 @@ gui2d::TexturedQuadRenderer::~TexturedQuadRenderer(void) {
  * performed.
  * @param quads The number of quads we need to be able to store
  */
-void gui2d::TexturedQuadRenderer::resizeBuffers(uint16_t quads) {
-	_tCoords = static_cast<glm::u16vec3*>(realloc(_tCoords, quads*4*sizeof(glm::u16vec3)));
+void gui2d::TexturedQuadRenderer::resizeBuffers(uint32_t quads) {
+	_tCoords = static_cast<glm::u16vec4*>(realloc(_tCoords, quads*getAttribSize()));
+}
+
+/**
+ * Points the vertex and texture coordinate attributes at the given buffers
+ * @param vertexBuffer The buffer holding vertex coordinates, starting at offset zero
+ * @param texBuffer The buffer holding texture coordinates
+ * @param texOffset Byte offset of the first texture coordinate within texBuffer
+ */
+void gui2d::TexturedQuadRenderer::bindAttributes(GLuint vertexBuffer, GLuint texBuffer, GLintptr texOffset) {
+	GLsizei stride = _instanced ? getAttribSize() : sizeof(glm::u16vec4);
+
+	glBindVertexArray(_vao);
+	bindVertexAttributes(vertexBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, texBuffer);
+	glVertexAttribPointer(_s_tex, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<GLvoid *>(texOffset));
+	glEnableVertexAttribArray(_s_tex);
+
+	// Instanced quads carry the texture coordinates of their opposite corner as well
+	if (_instanced) {
+		glVertexAttribDivisor(_s_tex, 1);
+		glVertexAttribPointer(_s_texMax, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+								reinterpret_cast<GLvoid *>(texOffset + sizeof(glm::u16vec4)));
+		glVertexAttribDivisor(_s_texMax, 1);
+		glEnableVertexAttribArray(_s_texMax);
+	}
+
+	glBindVertexArray(0);
+}
+
+/**
+ * Points the vertex attributes at our ordinary (non-streaming) vertex buffer objects
+ */
+void gui2d::TexturedQuadRenderer::bindBufferAttributes(void) {
+	bindAttributes(_vbo[0], _textureVBO, 0);
 }
 
 /**
  * Calls the appropriate render method for one specific item to update our arrays
  * @param iter The iterator pointing to the item to pass render() to
  * @param offset The array offset to use
+ * @param force Should the item copy its data even if it has not changed
  * @return Passes back the iterator's render response
  */
-bool gui2d::TexturedQuadRenderer::renderItem(RenderableIter& iter, uint16_t offset) {
-	return (*iter)->render(&_vCoords[4*offset], &_tCoords[4*offset], offset, false);
+bool gui2d::TexturedQuadRenderer::renderItem(RenderableIter& iter, uint32_t offset, bool force) {
+	if (_instanced)
+		return iter->second->renderInstance(&_vCoords[2*offset], &_tCoords[2*offset], offset, force);
+	return iter->second->render(&_vCoords[4*offset], &_tCoords[4*offset], offset, force);
+}
+
+/**
+ * Writes one item directly into a region of the streaming buffer
+ * @param iter The iterator pointing to the item to pass render() to
+ * @param vCoords Start of the vertex coordinates for the current region
+ * @param attribs Start of the texture coordinates for the current region
+ * @param offset The quad offset to use within the region
+ */
+void gui2d::TexturedQuadRenderer::streamItem(RenderableIter& iter, glm::i16vec3 *vCoords, GLubyte *attribs, uint32_t offset) {
+	glm::u16vec4 *tCoords = reinterpret_cast<glm::u16vec4 *>(attribs);
+	if (_instanced)
+		iter->second->renderInstance(&vCoords[2*offset], &tCoords[2*offset], offset, true);
+	else
+		iter->second->render(&vCoords[4*offset], &tCoords[4*offset], offset, true);
 }
 
 /**
- * Pushes the texture coordinate buffer to the gpu
+ * Re-specifies the texture coordinate vbo on the gpu so that it can hold a given number of quads
+ * @param quads The number of quads the vbo must be able to hold
  */
-void gui2d::TexturedQuadRenderer::updateBuffers(void) {
+void gui2d::TexturedQuadRenderer::reserveBuffers(uint32_t quads) {
 	glBindBuffer(GL_ARRAY_BUFFER, _textureVBO);
-	glBufferData(GL_ARRAY_BUFFER, _count*sizeof(glm::u16vec3)*4, _tCoords, GL_DYNAMIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, quads*getAttribSize(), 0, GL_DYNAMIC_DRAW);
 }
 
 /**
- * Rebinds textures a bunch and passes out several draw elements calls
+ * Pushes a range of the texture coordinate buffer to the gpu
+ * @param first The first quad to upload
+ * @param quads The number of quads to upload
+ * @return The number of bytes uploaded
  */
-void gui2d::TexturedQuadRenderer::drawElements(void) {
-	RenderableIter iter;
-	GLuint lastTextureId = 0;
-	uint16_t currentQuad = 0;
-	uint16_t offset = 0;
+size_t gui2d::TexturedQuadRenderer::updateBuffers(uint32_t first, uint32_t quads) {
+	glBindBuffer(GL_ARRAY_BUFFER, _textureVBO);
+	glBufferSubData(GL_ARRAY_BUFFER, first*getAttribSize(), quads*getAttribSize(), &_tCoords[_quadVerts*first]);
+	return quads*getAttribSize();
+}
 
-	// Make sure our texture is enabled and our uniform is set properly
-	glActiveTexture(GL_TEXTURE0);
-	glUniform1i(_gs_tex, 0);
+/**
+ * Groups the visible quads into runs that share a texture. With indexed drawing, the index
+ * buffer is rewritten so that every quad using a texture is contiguous, giving one run per
+ * texture; it is only rewritten when the texture assignments or slots have changed. Instanced
+ * quads cannot be reordered without moving their data, so only neighboring slots that share a
+ * texture are merged.
+ */
+void gui2d::TexturedQuadRenderer::buildBatches(void) {
+	RenderableIter iter;
+	std::vector<TexturedQuad>::iterator quad;
+	iTexturedQuadRenderable *r;
+	uint16_t currentQuad;
+	uint32_t position = 0;
+	Batch batch;
 
-	// Iterate over renderables and draw them
+	_quads.clear();
 	for (iter = _drawItems.begin(); iter != _drawItems.end(); ++iter) {
-		for (currentQuad = 0; currentQuad < (*iter)->getQuadCount(); ++currentQuad) {
-			// Only update texture ID if they have changed
-			if (lastTextureId != (*iter)->getTextureId(currentQuad)) {
-				lastTextureId = (*iter)->getTextureId(currentQuad);
-				glBindTexture(GL_TEXTURE_2D, lastTextureId);
+		r = iter->second;
+		for (currentQuad = 0; currentQuad < r->getQuadCount(); ++currentQuad) {
+			_quads.push_back(TexturedQuad(r->getGLTextureId(currentQuad), iter->first + currentQuad));
+		}
+	}
+
+	if (!_instanced)
+		std::sort(_quads.begin(), _quads.end());
+
+	// Batches are still valid if nothing moved and the index buffer was not rebuilt underneath them
+	if (_quads == _batchQuads && _batchBufferSize == _bufferSize)
+		return;
+
+	_batches.clear();
+	for (quad = _quads.begin(); quad != _quads.end(); ++quad, ++position) {
+		if (_instanced) {
+			if (!_batches.empty() && _batches.back().texture == quad->first &&
+					_batches.back().first + _batches.back().count == quad->second) {
+				_batches.back().count += 1;
+				continue;
 			}
-		
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, reinterpret_cast<GLvoid *>(offset*6*sizeof(GLushort)));
-			offset += 1;
+			batch.first = quad->second;
 		}
+		else {
+			setIndex(quad->second, position);
+			if (!_batches.empty() && _batches.back().texture == quad->first) {
+				_batches.back().count += 1;
+				continue;
+			}
+			batch.first = position;
+		}
+
+		batch.texture = quad->first;
+		batch.count = 1;
+		_batches.push_back(batch);
+	}
+
+	// Push the reordered indices, which reference the same vertices as before
+	if (!_instanced && position > 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, position*6*_indexSize, _index);
+		_bytesUploaded += position*6*_indexSize;
+	}
+
+	_batchQuads.swap(_quads);
+	_batchBufferSize = _bufferSize;
+}
+
+/**
+ * Binds each batch's texture and draws the batch with a single call. Every atlased quad
+ * shares the atlas array texture, which is bound to its own texture unit.
+ */
+void gui2d::TexturedQuadRenderer::drawElements(void) {
+	std::vector<Batch>::iterator iter;
+	GLuint atlasTexture = TextureAtlas::getSingleton().getTexture();
+	bool layered;
+
+	// Make sure our textures are enabled and our uniforms are set properly
+	glUniform1i(_gs_tex, 0);
+	glUniform1i(_gs_texArray, 1);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, atlasTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	buildBatches();
+
+	for (iter = _batches.begin(); iter != _batches.end(); ++iter) {
+		layered = (iter->texture == atlasTexture);
+		glUniform1i(_gs_layered, layered);
+		if (!layered)
+			glBindTexture(GL_TEXTURE_2D, iter->texture);
+
+		if (_instanced)
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, iter->count, _baseInstance + iter->first);
+		else
+			glDrawElementsBaseVertex(GL_TRIANGLES, 6*iter->count, _indexType,
+										reinterpret_cast<GLvoid *>(iter->first*6*_indexSize), _baseVertex);
+		_drawCalls += 1;
 	}
 }
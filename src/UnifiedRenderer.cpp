@@ -0,0 +1,272 @@
+/**
+ * @file 2dgui/UnifiedRenderer.cpp
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <algorithm>
+#include <cstddef>
+
+// Project definitions
+#include "Shader.h"
+#include "2dgui/gui2d.h"
+#include "2dgui/UnifiedRenderer.h"
+#include "2dgui/iUntexturedQuadRenderable.h"
+#include "2dgui/iTexturedQuadRenderable.h"
+#include "2dgui/TextureAtlas.h"
+#include "2dgui/String.h"
+
+/**
+ * Creates the vertex array and buffers and binds the interleaved vertex format to the shader
+ * @param s The unified shader program
+ */
+gui2d::UnifiedRenderer::UnifiedRenderer(Shader *s) : _shader(s), _vao(0), _indexQuads(0), _bytesUploaded(0), _drawCalls(0) {
+	_s_vert = s->getAttribLocation("in_vert");
+	_s_mode = s->getAttribLocation("in_mode");
+	_s_tex = s->getAttribLocation("in_tex");
+	_s_color = s->getAttribLocation("in_color");
+	_gs_tex = s->getUniformLocation("tex");
+	_gs_texArray = s->getUniformLocation("texArray");
+
+	glGenVertexArrays(1, &_vao);
+	glBindVertexArray(_vao);
+	glGenBuffers(2, _vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
+	glVertexAttribPointer(_s_vert, 3, GL_SHORT, GL_TRUE, sizeof(Vertex), reinterpret_cast<GLvoid *>(offsetof(Vertex, pos)));
+	glEnableVertexAttribArray(_s_vert);
+	glVertexAttribIPointer(_s_mode, 1, GL_UNSIGNED_SHORT, sizeof(Vertex), reinterpret_cast<GLvoid *>(offsetof(Vertex, mode)));
+	glEnableVertexAttribArray(_s_mode);
+	glVertexAttribPointer(_s_tex, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), reinterpret_cast<GLvoid *>(offsetof(Vertex, tex)));
+	glEnableVertexAttribArray(_s_tex);
+	glVertexAttribPointer(_s_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), reinterpret_cast<GLvoid *>(offsetof(Vertex, color)));
+	glEnableVertexAttribArray(_s_color);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
+	glBindVertexArray(0);
+}
+
+/**
+ * Releases the opengl resources
+ */
+gui2d::UnifiedRenderer::~UnifiedRenderer(void) {
+	glBindVertexArray(0);
+	glDeleteBuffers(2, _vbo);
+	glDeleteVertexArrays(1, &_vao);
+}
+
+/**
+ * Starts a new frame, discarding the quads added for the previous one
+ */
+void gui2d::UnifiedRenderer::begin(void) {
+	_vertices.clear();
+	_keys.clear();
+}
+
+/**
+ * Appends one quad to the unsorted stream
+ * @param v The quad's four vertices
+ * @param texture The 2D texture that must be bound to draw it, or 0 if none is needed
+ */
+void gui2d::UnifiedRenderer::addQuad(const Vertex *v, GLuint texture) {
+	QuadKey key;
+
+	key.z = v[0].pos.z;
+	key.texture = texture;
+	key.vertex = _vertices.size();
+	_keys.push_back(key);
+	_vertices.insert(_vertices.end(), v, v + 4);
+}
+
+/**
+ * Adds every quad of an untextured renderable to this frame
+ * @param r The renderable to draw
+ */
+void gui2d::UnifiedRenderer::add(iUntexturedQuadRenderable *r) {
+	const glm::i16vec3 *vCoords = r->getVertexData();
+	const glm::u8vec4 *vColors = r->getColorData();
+	Vertex v[4];
+	uint16_t quad;
+	int i;
+
+	for (quad = 0; quad < r->getQuadCount(); ++quad) {
+		for (i = 0; i < 4; ++i) {
+			v[i].pos = vCoords[4*quad + i];
+			v[i].mode = MODE_COLOR;
+			v[i].tex = glm::u16vec4(0);
+			v[i].color = vColors[4*quad + i];
+		}
+		addQuad(v, 0);
+	}
+}
+
+/**
+ * Adds every quad of a textured renderable to this frame. Atlased quads sample the atlas
+ * array, which is always bound, so they do not constrain batching.
+ * @param r The renderable to draw
+ */
+void gui2d::UnifiedRenderer::add(iTexturedQuadRenderable *r) {
+	const glm::i16vec3 *vCoords = r->getVertexData();
+	Vertex v[4];
+	uint16_t quad;
+	GLushort mode;
+	GLuint texture;
+	int i;
+
+	for (quad = 0; quad < r->getQuadCount(); ++quad) {
+		if (TextureAtlas::isHandle(r->getTextureId(quad))) {
+			mode = MODE_ATLAS;
+			texture = 0;
+		}
+		else {
+			mode = MODE_TEXTURE;
+			texture = r->getGLTextureId(quad);
+		}
+
+		for (i = 0; i < 4; ++i) {
+			v[i].pos = vCoords[4*quad + i];
+			v[i].mode = mode;
+			v[i].tex = r->getTexCoord(quad, i);
+			v[i].color = glm::u8vec4(255);
+		}
+		addQuad(v, texture);
+	}
+}
+
+/**
+ * Adds every glyph of a visible string to this frame
+ * @param s The string to draw
+ */
+void gui2d::UnifiedRenderer::add(String *s) {
+	const glm::u16vec2 *tCoords;
+	const glm::vec4& c = s->getColor();
+	glm::u8vec4 color(static_cast<uint8_t>(glm::clamp(c.r, 0.0f, 1.0f)*255),
+						static_cast<uint8_t>(glm::clamp(c.g, 0.0f, 1.0f)*255),
+						static_cast<uint8_t>(glm::clamp(c.b, 0.0f, 1.0f)*255),
+						static_cast<uint8_t>(glm::clamp(c.a, 0.0f, 1.0f)*255));
+	GLshort z = static_cast<GLshort>(s->getZ());
+	GLushort mode = s->getFont()->isDistanceField() ? MODE_DISTANCE : MODE_GLYPH;
+	Vertex v[4];
+	int quad, i;
+
+	if (!s->isVisible())
+		return;
+
+	s->refresh();
+	tCoords = s->getTexData();
+
+	for (quad = 0; quad < s->getVertexCount()/4; ++quad) {
+		for (i = 0; i < 4; ++i) {
+			v[i].pos = glm::i16vec3(s->getPosition(4*quad + i), z);
+			v[i].mode = mode;
+			v[i].tex = glm::u16vec4(tCoords[4*quad + i].x, tCoords[4*quad + i].y, 0, 0);
+			v[i].color = color;
+		}
+		addQuad(v, s->getFont()->getTextureId());
+	}
+}
+
+/**
+ * Sorts the quads back to front, copies them into drawing order, and splits them into runs
+ * that can share a bound 2D texture
+ */
+void gui2d::UnifiedRenderer::buildBatches(void) {
+	std::vector<QuadKey>::iterator key;
+	uint32_t quad = 0;
+	Batch batch;
+
+	std::stable_sort(_keys.begin(), _keys.end());
+
+	_sorted.resize(_vertices.size());
+	_batches.clear();
+
+	for (key = _keys.begin(); key != _keys.end(); ++key, ++quad) {
+		std::copy(&_vertices[key->vertex], &_vertices[key->vertex] + 4, &_sorted[4*quad]);
+
+		if (!_batches.empty()) {
+			Batch& last = _batches.back();
+			if (key->texture == 0 || last.texture == 0 || key->texture == last.texture) {
+				if (last.texture == 0)
+					last.texture = key->texture;
+				last.count += 1;
+				continue;
+			}
+		}
+
+		batch.texture = key->texture;
+		batch.first = quad;
+		batch.count = 1;
+		_batches.push_back(batch);
+	}
+}
+
+/**
+ * Makes sure that the index buffer covers a number of quads, which never changes for a
+ * given quad since the stream is always drawn in order
+ * @param quads The number of quads that will be drawn
+ */
+void gui2d::UnifiedRenderer::ensureIndices(uint32_t quads) {
+	std::vector<GLuint> index;
+	uint32_t i;
+
+	if (quads <= _indexQuads)
+		return;
+
+	_indexQuads = std::max(quads, 2*_indexQuads);
+	index.resize(_indexQuads*6);
+	for (i = 0; i < _indexQuads; ++i) {
+		index[6*i] = 4*i;
+		index[6*i+1] = 4*i + 2;
+		index[6*i+2] = 4*i + 3;
+		index[6*i+3] = 4*i;
+		index[6*i+4] = 4*i + 1;
+		index[6*i+5] = 4*i + 2;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size()*sizeof(GLuint), &index[0], GL_STATIC_DRAW);
+	_bytesUploaded += index.size()*sizeof(GLuint);
+}
+
+/**
+ * Draws everything added since begin() in z order
+ */
+void gui2d::UnifiedRenderer::render(void) {
+	std::vector<Batch>::iterator iter;
+
+	_bytesUploaded = 0;
+	_drawCalls = 0;
+
+	if (_keys.empty())
+		return;
+
+	buildBatches();
+
+	_shader->use();
+	glBindVertexArray(_vao);
+	ensureIndices(_keys.size());
+
+	// The whole stream is replaced, so let the driver orphan the old storage
+	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, _sorted.size()*sizeof(Vertex), &_sorted[0], GL_STREAM_DRAW);
+	_bytesUploaded += _sorted.size()*sizeof(Vertex);
+
+	glUniform1i(_gs_tex, 0);
+	glUniform1i(_gs_texArray, 1);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, TextureAtlas::getSingleton().getTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	for (iter = _batches.begin(); iter != _batches.end(); ++iter) {
+		if (iter->texture)
+			glBindTexture(GL_TEXTURE_2D, iter->texture);
+		glDrawElements(GL_TRIANGLES, 6*iter->count, GL_UNSIGNED_INT, reinterpret_cast<GLvoid *>(iter->first*6*sizeof(GLuint)));
+		_drawCalls += 1;
+	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -20,7 +20,7 @@
  * all of our vertex color and coordinate locations.
  * @param quads The number of quads to save space for
  */
-gui2d::iQuadRenderable::iQuadRenderable(uint16_t quads) : _count(quads), _prevOffset(USHRT_MAX),
+gui2d::iQuadRenderable::iQuadRenderable(uint16_t quads) : _count(quads), _prevOffset(UINT32_MAX),
 		_modified(true), _vCoords(0) {
 	_vCoords = static_cast<glm::i16vec3 *>(calloc(1, _count*4*sizeof(glm::i16vec3)));
 }
@@ -118,7 +118,7 @@ void gui2d::iQuadRenderable::setQuadPosition(uint16_t quad, const glm::i16vec3&
  * @param force Should we force an update (master array was corrupted for some reason)
  * @return Did we change the input arrays?
  */
-bool gui2d::iQuadRenderable::render(glm::i16vec3 *vCoords, uint16_t offset, bool force) {
+bool gui2d::iQuadRenderable::render(glm::i16vec3 *vCoords, uint32_t offset, bool force) {
 	if (force || _modified || (offset != _prevOffset)) {
 		std::memcpy(vCoords, _vCoords, _count*4*sizeof(glm::i16vec3));
 
@@ -129,3 +129,28 @@ bool gui2d::iQuadRenderable::render(glm::i16vec3 *vCoords, uint16_t offset, bool
 
 	return false;
 }
+
+/**
+ * Rendering method for instanced drawing, which copies only the bottom left and top right
+ * corners of each quad, since the other two can be derived from them
+ * @param corners The array to copy our corners to, two per quad
+ * @param offset Our offset within the master array
+ * @param force Should we force an update (master array was corrupted for some reason)
+ * @return Did we change the input arrays?
+ */
+bool gui2d::iQuadRenderable::renderInstance(glm::i16vec3 *corners, uint32_t offset, bool force) {
+	uint16_t i;
+
+	if (force || _modified || (offset != _prevOffset)) {
+		for (i = 0; i < _count; ++i) {
+			corners[2*i] = _vCoords[4*i];
+			corners[2*i+1] = _vCoords[4*i+2];
+		}
+
+		_modified = false;
+		_prevOffset = offset;
+		return true;
+	}
+
+	return false;
+}
@@ -12,14 +12,15 @@
 #include "2dgui/gui2d.h"
 #include "2dgui/iQuadRenderable.h"
 #include "2dgui/iTexturedQuadRenderable.h"
+#include "2dgui/TextureAtlas.h"
 
 /**
  * Construct a textured quad object with a given number of quads
  * @param quads The number of quads to draw
  */
-gui2d::iTexturedQuadRenderable::iTexturedQuadRenderable(uint16_t quads) : iQuadRenderable(quads), _tId(0), _tCoords(0) {
+gui2d::iTexturedQuadRenderable::iTexturedQuadRenderable(uint16_t quads) : iQuadRenderable(quads), _tId(0), _tCoords(0), _atlasGeneration(0) {
 	_tId = static_cast<GLuint *>(calloc(1, _count*sizeof(GLuint)));
-	_tCoords = static_cast<glm::u16vec3 *>(calloc(1, _count*4*sizeof(glm::u16vec3)));
+	_tCoords = static_cast<glm::u16vec4 *>(calloc(1, _count*4*sizeof(glm::u16vec4)));
 }
 
 /**
@@ -90,6 +91,49 @@ void gui2d::iTexturedQuadRenderable::setQuadAlpha(uint16_t quad, GLushort alpha)
 	_modified = true;
 }
 
+/**
+ * Retrieves the texture that must be bound to draw a specific quad, which is the atlas array
+ * texture for atlased images
+ * @param quad The quad to look up
+ * @return The opengl texture name
+ */
+GLuint gui2d::iTexturedQuadRenderable::getGLTextureId(uint16_t quad) const {
+	if (TextureAtlas::isHandle(_tId[quad]))
+		return TextureAtlas::getSingleton().getTexture();
+	return _tId[quad];
+}
+
+/**
+ * Maps a texture coordinate relative to a quad's image into its texture, which only
+ * changes it if the image is in the atlas
+ * @param quad The quad whose image is used
+ * @param tc The image-relative coordinate, with alpha in z
+ * @return The coordinate within the texture that is bound for the quad, with the atlas layer in w
+ */
+glm::u16vec4 gui2d::iTexturedQuadRenderable::mapTexCoord(uint16_t quad, const glm::u16vec4& tc) const {
+	if (!TextureAtlas::isHandle(_tId[quad]))
+		return tc;
+
+	const TextureAtlas::Entry& entry = TextureAtlas::getSingleton().getEntry(_tId[quad]);
+	return glm::u16vec4(entry.uv.x + (static_cast<uint32_t>(tc.x)*(entry.uv.z - entry.uv.x))/USHRT_MAX,
+						entry.uv.y + (static_cast<uint32_t>(tc.y)*(entry.uv.w - entry.uv.y))/USHRT_MAX, tc.z, entry.page);
+}
+
+/**
+ * Checks whether the atlas has moved images since our coordinates were last copied, in
+ * which case they must be copied again
+ * @return True if the atlas has changed
+ */
+bool gui2d::iTexturedQuadRenderable::refreshAtlas(void) {
+	uint32_t generation = TextureAtlas::getSingleton().getGeneration();
+
+	if (generation != _atlasGeneration) {
+		_atlasGeneration = generation;
+		return true;
+	}
+	return false;
+}
+
 /**
  * Renders to the arrays given, but only when necessary
  * @param vCoords The vertex coordinate array to copy our vertex data to
@@ -98,9 +142,37 @@ void gui2d::iTexturedQuadRenderable::setQuadAlpha(uint16_t quad, GLushort alpha)
  * @param force Should we force an update (master array was corrupted for some reason)
  * @return Did we change the input arrays?
  */
-bool gui2d::iTexturedQuadRenderable::render(glm::i16vec3 * __restrict vCoords, glm::u16vec3 * __restrict tCoords, int offset, bool force) {
+bool gui2d::iTexturedQuadRenderable::render(glm::i16vec3 * __restrict vCoords, glm::u16vec4 * __restrict tCoords, uint32_t offset, bool force) {
+	uint16_t i;
+
+	force = refreshAtlas() || force;
 	if (static_cast<iQuadRenderable*>(this)->render(vCoords, offset, force)) {
-		std::memcpy(tCoords, _tCoords, _count*4*sizeof(glm::u16vec3));
+		for (i = 0; i < _count*4; ++i) {
+			tCoords[i] = mapTexCoord(i/4, _tCoords[i]);
+		}
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Renders to the arrays given for instanced drawing, with the texture coordinates of the
+ * bottom left and top right corners of each quad
+ * @param corners The array to copy our corners to, two per quad
+ * @param tCorners The array to copy our corner texture coordinates to, two per quad
+ * @param offset Our offset within the master array
+ * @param force Should we force an update (master array was corrupted for some reason)
+ * @return Did we change the input arrays?
+ */
+bool gui2d::iTexturedQuadRenderable::renderInstance(glm::i16vec3 * __restrict corners, glm::u16vec4 * __restrict tCorners, uint32_t offset, bool force) {
+	uint16_t i;
+
+	force = refreshAtlas() || force;
+	if (static_cast<iQuadRenderable*>(this)->renderInstance(corners, offset, force)) {
+		for (i = 0; i < _count; ++i) {
+			tCorners[2*i] = mapTexCoord(i, _tCoords[4*i]);
+			tCorners[2*i+1] = mapTexCoord(i, _tCoords[4*i+2]);
+		}
 		return true;
 	}
 	return false;
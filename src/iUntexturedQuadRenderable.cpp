@@ -116,10 +116,31 @@ void gui2d::iUntexturedQuadRenderable::setQuadAlpha(uint16_t quad, float alpha)
  * @param force Should we force an update (master array was corrupted for some reason)
  * @return Did we change the input arrays?
  */
-bool gui2d::iUntexturedQuadRenderable::render(glm::i16vec3 * __restrict vCoords, glm::u8vec4 * __restrict vColors, uint16_t offset, bool force) {
+bool gui2d::iUntexturedQuadRenderable::render(glm::i16vec3 * __restrict vCoords, glm::u8vec4 * __restrict vColors, uint32_t offset, bool force) {
 	if (static_cast<iQuadRenderable*>(this)->render(vCoords, offset, force)) {
 		std::memcpy(vColors, _vColors, _count*4*sizeof(glm::u8vec4));
 		return true;
 	}
 	return false;
 }
+
+/**
+ * Called by the Renderer when drawing instanced quads, to copy two corners and a single
+ * color per quad into the master arrays at a specific offset
+ * @param corners The array to copy our corners to, two per quad
+ * @param colors The array to copy our colors to, one per quad
+ * @param offset Our offset within the master array
+ * @param force Should we force an update (master array was corrupted for some reason)
+ * @return Did we change the input arrays?
+ */
+bool gui2d::iUntexturedQuadRenderable::renderInstance(glm::i16vec3 * __restrict corners, glm::u8vec4 * __restrict colors, uint32_t offset, bool force) {
+	uint16_t i;
+
+	if (static_cast<iQuadRenderable*>(this)->renderInstance(corners, offset, force)) {
+		for (i = 0; i < _count; ++i) {
+			colors[i] = _vColors[4*i];
+		}
+		return true;
+	}
+	return false;
+}
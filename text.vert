@@ -1,18 +1,18 @@
 #version 330
 
-// Vertex shader for the text renderer, unpacks the vec4 data type used to conserve memory
+// Vertex shader for the batched text renderer, every glyph of every string using a font is drawn at once
 
-// Input is packed, xy are position, zw are texture coordinates 
-in vec2 in_vert;
+// Position and z of each glyph corner, along with its texture coordinates and the string's color
+in vec3 in_vert;
 in vec2 in_tex;
+in vec4 in_color;
 
-// Output to next step is just the texture coordinate data
+// Output to next step is the texture coordinate and color data
 out vec2 ex_texcoord;
-
-// Allow us to specify the z coordinate with a uniform (to determine stacking order)
-uniform float un_z;
+out vec4 ex_color;
 
 void main(void) {
-	gl_Position = vec4(in_vert, un_z/32767, 1);
+	gl_Position = vec4(in_vert, 1);
 	ex_texcoord = in_tex;
+	ex_color = in_color;
 }
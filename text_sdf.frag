@@ -0,0 +1,34 @@
+#version 330
+
+// Fragment shader for distance field text, thresholds the distance to find the glyph's edge
+in vec2 ex_texcoord;
+in vec4 ex_color;
+
+uniform sampler2D tex;
+
+// Outline width is a fraction of the spread, and the shadow offset is in texels
+uniform float un_outlineWidth;
+uniform vec4 un_outlineColor;
+uniform vec2 un_shadowOffset;
+uniform vec4 un_shadowColor;
+
+// Composites one non-premultiplied color over another
+vec4 over(vec4 top, vec4 bottom) {
+	float a = top.a + bottom.a*(1.0 - top.a);
+	if (a <= 0.0)
+		return vec4(0.0);
+	return vec4((top.rgb*top.a + bottom.rgb*bottom.a*(1.0 - top.a))/a, a);
+}
+
+void main(void) {
+	float dist = texture2D(tex, ex_texcoord).r;
+	float edge = fwidth(dist);
+	float outer = 0.5 - 0.5*un_outlineWidth;
+	float shadowDist = texture2D(tex, ex_texcoord - un_shadowOffset/vec2(textureSize(tex, 0))).r;
+
+	vec4 glyph = vec4(ex_color.rgb, ex_color.a*smoothstep(0.5 - edge, 0.5 + edge, dist));
+	vec4 outline = vec4(un_outlineColor.rgb, un_outlineColor.a*smoothstep(outer - edge, outer + edge, dist));
+	vec4 shadow = vec4(un_shadowColor.rgb, un_shadowColor.a*smoothstep(outer - edge, outer + edge, shadowDist));
+
+	gl_FragColor = over(glyph, over(outline, shadow));
+}
@@ -0,0 +1,116 @@
+/**
+ * @file 2dgui/tools/fontbake.cpp
+ * Offline baker for the font cache. Rasterizes a font at the given pixel sizes and writes
+ * the FontCache files that Manager::loadFont() looks for when Manager::setFontCache() points
+ * at the same directory, so that shipped builds never run FreeType at startup.
+ *
+ * Usage: fontbake <font file> <output directory> [--sdf] <size>...
+ * @todo License/copyright statement
+ */
+
+// Standard headers
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// Project definitions
+#include "2dgui/gui2d.h"
+#include "2dgui/Font.h"
+#include "2dgui/FontCache.h"
+#include "2dgui/MappedFile.h"
+
+/**
+ * Rasterizes one size of a font and writes it to the cache
+ * @param library The FreeType library
+ * @param path Path to the font file
+ * @param hash Hash of the font file
+ * @param outDir Directory to write the cache file to
+ * @param size Pixel size to rasterize at
+ * @param distanceField Rasterize distance fields instead of coverage
+ * @return True if the cache file was written
+ */
+static bool bake(FT_Library library, const std::string& path, uint64_t hash, const std::string& outDir, int size, bool distanceField) {
+	gui2d::Font::FaceRaster raster;
+	std::string cachePath = outDir + "/" + gui2d::FontCache::getName(hash, size, distanceField);
+	FT_Face face;
+	bool loaded;
+
+	if (!gui2d::Font::openFace(library, path, size, face, std::cerr))
+		return false;
+
+	loaded = gui2d::Font::rasterize(face, distanceField, raster, std::cerr);
+	FT_Done_Face(face);
+	if (!loaded)
+		return false;
+
+	if (!gui2d::FontCache::write(cachePath, hash, size, distanceField, raster)) {
+		std::cerr << "fontbake: could not write " << cachePath << std::endl;
+		return false;
+	}
+
+	std::cout << cachePath << std::endl;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	FT_Library library;
+	gui2d::MappedFile file;
+	std::string path, outDir;
+	uint64_t hash;
+	bool distanceField = false;
+	bool baked = false;
+	int failures = 0;
+	int i, size;
+
+	if (argc < 4) {
+		std::cerr << "Usage: " << argv[0] << " <font file> <output directory> [--sdf] <size>..." << std::endl;
+		return 1;
+	}
+
+	path = argv[1];
+	outDir = argv[2];
+
+	if (!file.open(path)) {
+		std::cerr << "fontbake: could not open " << path << std::endl;
+		return 1;
+	}
+	hash = gui2d::FontCache::hash(file);
+
+	if (FT_Init_FreeType(&library)) {
+		std::cerr << "fontbake: unable to initialize FreeType library" << std::endl;
+		return 1;
+	}
+	gui2d::Font::configureLibrary(library);
+
+	for (i = 3; i < argc; ++i) {
+		// Distance fields serve every size, so they are only baked once, at their own size
+		if (strcmp(argv[i], "--sdf") == 0) {
+			distanceField = true;
+			continue;
+		}
+
+		size = atoi(argv[i]);
+		if (size <= 0) {
+			std::cerr << "fontbake: invalid size " << argv[i] << std::endl;
+			failures += 1;
+			continue;
+		}
+
+		if (!bake(library, path, hash, outDir, size, false))
+			failures += 1;
+		baked = true;
+	}
+
+	if (distanceField && !bake(library, path, hash, outDir, gui2d::Font::DISTANCE_SIZE, true))
+		failures += 1;
+
+	if (!baked && !distanceField)
+		std::cerr << "fontbake: no sizes given" << std::endl;
+
+	FT_Done_FreeType(library);
+	return (failures || (!baked && !distanceField)) ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#version 330
+
+// Fragment shader for the unified pass, picks a coloring method per vertex
+flat in uint ex_mode;
+in vec4 ex_tex;
+in vec4 ex_color;
+
+uniform sampler2D tex;
+uniform sampler2DArray texArray;
+
+void main(void) {
+	vec4 texSample;
+
+	if (ex_mode == 0u) {
+		// Untextured quads
+		gl_FragColor = ex_color;
+	}
+	else if (ex_mode == 1u) {
+		// Textured quads, alpha is carried in the texture coordinates
+		texSample = texture(tex, ex_tex.xy);
+		gl_FragColor = vec4(texSample.rgb, ex_tex.z * texSample.a);
+	}
+	else if (ex_mode == 2u) {
+		// Atlased quads, the layer is carried in the texture coordinates as well
+		texSample = texture(texArray, vec3(ex_tex.xy, floor(ex_tex.w * 65535.0 + 0.5)));
+		gl_FragColor = vec4(texSample.rgb, ex_tex.z * texSample.a);
+	}
+	else if (ex_mode == 3u) {
+		// Glyphs, coverage comes from the font texture
+		gl_FragColor = vec4(ex_color.rgb, ex_color.a * texture(tex, ex_tex.xy).r);
+	}
+	else {
+		// Distance field glyphs, coverage comes from thresholding the distance at the edge
+		float dist = texture(tex, ex_tex.xy).r;
+		float edge = fwidth(dist);
+		gl_FragColor = vec4(ex_color.rgb, ex_color.a * smoothstep(0.5 - edge, 0.5 + edge, dist));
+	}
+}
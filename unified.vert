@@ -0,0 +1,21 @@
+#version 330
+
+// Vertex shader for the unified pass, which draws quads and text in one stream
+
+// 3D coordinate input, with z used for stacking order
+in vec3 in_vert;
+in uint in_mode;
+in vec4 in_tex;
+in vec4 in_color;
+
+// How the fragment shader should color this vertex, see UnifiedRenderer::Mode
+flat out uint ex_mode;
+out vec4 ex_tex;
+out vec4 ex_color;
+
+void main(void) {
+	gl_Position = vec4(in_vert.xy, in_vert.z, 1);
+	ex_mode = in_mode;
+	ex_tex = in_tex;
+	ex_color = in_color;
+}